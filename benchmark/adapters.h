@@ -0,0 +1,399 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+
+#include "concurrent-skiplist/concurrent_skiplist.h"
+#include "leveldb-skiplist/skiplist.h"
+
+#define SIMPLE_SKIPLIST_NO_MAIN
+#include "simple_skiplsit.cpp"
+
+/**
+ * @brief 为各个跳表实现提供统一的操作接口，供benchmark和workload驱动使用
+ *
+ * 每个Adapter提供：
+ *   bool Insert(key)    插入，key已存在时返回false
+ *   bool Contains(key)  查找
+ *   bool Erase(key)     删除，key不存在时返回false
+ *   bool Seek(key, &k)  定位到第一个>=key的元素
+ *   uint64_t Scan(key, n)  从第一个>=key的元素开始顺序读取n个元素
+ *   uint64_t ScanAll()  全表扫描
+ * kOrdered为false的实现不支持Seek/Scan。
+ */
+
+namespace utility {
+namespace skiplist {
+namespace bench {
+
+typedef uint64_t BenchKey;
+
+struct LevelDBComparator {
+  int operator()(const BenchKey& a, const BenchKey& b) const {
+    if (a < b) {
+      return -1;
+    } else if (a > b) {
+      return 1;
+    } else {
+      return 0;
+    }
+  }
+};
+
+// leveldb SkipList guarded by an external mutex, as its header requires for
+// writers.  Readers do not lock, an EpochGuard keeps the nodes they are on
+// from being freed by a concurrent Erase().
+template <class Allocator, bool PrevLinks = false>
+class BasicLevelDBSkipListAdapter {
+ public:
+  typedef utility::skiplist::SkipList<BenchKey, LevelDBComparator, Allocator,
+                                      PrevLinks>
+      List;
+  static const bool kOrdered = true;
+  static const bool kThreadSafe = true;
+
+  explicit BasicLevelDBSkipListAdapter(Allocator allocator)
+      : list_(LevelDBComparator(), std::move(allocator)) {}
+
+  bool Insert(BenchKey key) {
+    std::lock_guard<std::mutex> g(mu_);
+    return list_.Insert(key);
+  }
+
+  bool Contains(BenchKey key) {
+    utility::skiplist::EpochGuard g;
+    return list_.Contains(key);
+  }
+
+  bool Erase(BenchKey key) {
+    std::lock_guard<std::mutex> g(mu_);
+    return list_.Delete(key);
+  }
+
+  bool Seek(BenchKey key, BenchKey* found) {
+    utility::skiplist::EpochGuard g;
+    typename List::Iterator iter(&list_);
+    iter.Seek(key);
+    if (!iter.Valid()) {
+      return false;
+    }
+    *found = iter.key();
+    return true;
+  }
+
+  uint64_t Scan(BenchKey key, uint64_t n) {
+    utility::skiplist::EpochGuard g;
+    typename List::Iterator iter(&list_);
+    uint64_t sum = 0;
+    for (iter.Seek(key); n > 0 && iter.Valid(); iter.Next(), --n) {
+      sum += iter.key();
+    }
+    return sum;
+  }
+
+  uint64_t ScanAll() {
+    utility::skiplist::EpochGuard g;
+    typename List::Iterator iter(&list_);
+    uint64_t sum = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+      sum += iter.key();
+    }
+    return sum;
+  }
+
+  // From the last key to the first with Iterator::Prev().
+  uint64_t ReverseScanAll() {
+    utility::skiplist::EpochGuard g;
+    typename List::Iterator iter(&list_);
+    uint64_t sum = 0;
+    for (iter.SeekToLast(); iter.Valid(); iter.Prev()) {
+      sum += iter.key();
+    }
+    return sum;
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> g(mu_);
+    return list_.size();
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> g(mu_);
+    list_.Clear();
+  }
+
+  // [first, last) must be sorted.
+  size_t InsertBatch(const BenchKey* first, const BenchKey* last) {
+    std::lock_guard<std::mutex> g(mu_);
+    return list_.InsertBatch(first, last);
+  }
+
+  // [first, last) must be sorted.
+  void Assign(const BenchKey* first, const BenchKey* last) {
+    std::lock_guard<std::mutex> g(mu_);
+    list_.Assign(first, last);
+  }
+
+  List* list() { return &list_; }
+  std::mutex& mutex() { return mu_; }
+
+ private:
+  std::mutex mu_;
+  List list_;
+};
+
+// The default TLSFAllocator, either on a MemoryPoolTLSF owned by the list or
+// on malloc.
+class LevelDBSkipListAdapter
+    : public BasicLevelDBSkipListAdapter<utility::skiplist::TLSFAllocator> {
+ public:
+  explicit LevelDBSkipListAdapter(bool use_tlsf)
+      : BasicLevelDBSkipListAdapter(
+            use_tlsf ? utility::skiplist::TLSFAllocator::Owning()
+                     : utility::skiplist::TLSFAllocator()) {}
+
+  // nullptr when the list allocates with malloc.
+  MemoryPoolTLSF* pool() { return list()->allocator().pool(); }
+};
+
+// Bump allocation from a leveldb Arena owned by the list; erased nodes are
+// not reused.
+class LevelDBArenaSkipListAdapter
+    : public BasicLevelDBSkipListAdapter<utility::skiplist::ArenaAllocator> {
+ public:
+  LevelDBArenaSkipListAdapter()
+      : BasicLevelDBSkipListAdapter(
+            utility::skiplist::ArenaAllocator::Owning()) {}
+
+  Arena* arena() { return list()->allocator().arena(); }
+};
+
+// LevelDBSkipListAdapter(true) with backward links on level 0.
+class LevelDBPrevSkipListAdapter
+    : public BasicLevelDBSkipListAdapter<utility::skiplist::TLSFAllocator,
+                                         true> {
+ public:
+  LevelDBPrevSkipListAdapter()
+      : BasicLevelDBSkipListAdapter(
+            utility::skiplist::TLSFAllocator::Owning()) {}
+};
+
+class ConcurrentSkipListAdapter {
+ public:
+  typedef utility::skiplist::ConcurrentSkipList<BenchKey> List;
+  static const bool kOrdered = true;
+  static const bool kThreadSafe = true;
+
+  ConcurrentSkipListAdapter() : list_(List::createInstance(1)) {}
+
+  // Every call builds its own Accessor, which is how callers without a long
+  // lived Accessor use the list.  Threads that keep one around should go
+  // through ThreadHandle instead.
+  bool Insert(BenchKey key) { return List::Accessor(list_).add(key); }
+  bool Contains(BenchKey key) { return List::Accessor(list_).contains(key); }
+  bool Erase(BenchKey key) { return List::Accessor(list_).remove(key); }
+
+  bool Seek(BenchKey key, BenchKey* found) {
+    List::Accessor accessor(list_);
+    auto iter = accessor.lower_bound(key);
+    if (iter == accessor.end()) {
+      return false;
+    }
+    *found = *iter;
+    return true;
+  }
+
+  uint64_t Scan(BenchKey key, uint64_t n) {
+    List::Accessor accessor(list_);
+    uint64_t sum = 0;
+    for (auto iter = accessor.lower_bound(key);
+         n > 0 && iter != accessor.end(); ++iter, --n) {
+      sum += *iter;
+    }
+    return sum;
+  }
+
+  uint64_t ScanAll() {
+    List::Accessor accessor(list_);
+    uint64_t sum = 0;
+    for (const auto& key : accessor) {
+      sum += key;
+    }
+    return sum;
+  }
+
+  size_t size() { return list_->size(); }
+
+  List::Accessor accessor() { return List::Accessor(list_); }
+  const std::shared_ptr<List>& list() { return list_; }
+
+ private:
+  std::shared_ptr<List> list_;
+};
+
+// Prints the Accessor latency percentiles, when they are compiled in.
+inline void PrintLatency(const ConcurrentSkipListAdapter::List& list) {
+#if SKIPLIST_ENABLE_LATENCY_HISTOGRAM
+  static const char* names[] = {"insert", "find", "erase", "lower_bound",
+                                "pop_back", "release"};
+  printf("  %-12s %12s %8s %8s %8s %8s %8s %10s\n", "latency(ns)", "count",
+         "mean", "p50", "p90", "p99", "p99.9", "max");
+  for (int i = 0; i < kNumLatencyOps; ++i) {
+    LatencySnapshot s = list.latency(static_cast<LatencyOp>(i));
+    if (s.count == 0) {
+      continue;
+    }
+    printf("  %-12s %12llu %8.0f %8llu %8llu %8llu %8llu %10llu\n", names[i],
+           (unsigned long long)s.count, s.mean, (unsigned long long)s.p50,
+           (unsigned long long)s.p90, (unsigned long long)s.p99,
+           (unsigned long long)s.p999, (unsigned long long)s.max);
+  }
+  fflush(stdout);
+#else
+  (void)list;
+#endif
+}
+
+// Per-thread view of an adapter, used by the multi-threaded drivers.  Lists
+// that keep per-thread state (the ConcurrentSkipList Accessor) specialize it.
+template <typename Adapter>
+class ThreadHandle {
+ public:
+  explicit ThreadHandle(Adapter* adapter) : adapter_(adapter) {}
+
+  bool Insert(BenchKey key) { return adapter_->Insert(key); }
+  bool Contains(BenchKey key) { return adapter_->Contains(key); }
+  bool Erase(BenchKey key) { return adapter_->Erase(key); }
+  bool Seek(BenchKey key, BenchKey* found) {
+    return adapter_->Seek(key, found);
+  }
+  uint64_t Scan(BenchKey key, uint64_t n) { return adapter_->Scan(key, n); }
+
+ private:
+  Adapter* adapter_;
+};
+
+// Holds one Accessor for the lifetime of the thread, so the recycler
+// refcount is only touched once.
+template <>
+class ThreadHandle<ConcurrentSkipListAdapter> {
+ public:
+  explicit ThreadHandle(ConcurrentSkipListAdapter* adapter)
+      : accessor_(adapter->list()) {}
+
+  bool Insert(BenchKey key) { return accessor_.add(key); }
+  bool Contains(BenchKey key) { return accessor_.contains(key); }
+  bool Erase(BenchKey key) { return accessor_.remove(key); }
+
+  bool Seek(BenchKey key, BenchKey* found) {
+    auto iter = accessor_.lower_bound(key);
+    if (iter == accessor_.end()) {
+      return false;
+    }
+    *found = *iter;
+    return true;
+  }
+
+  uint64_t Scan(BenchKey key, uint64_t n) {
+    uint64_t sum = 0;
+    for (auto iter = accessor_.lower_bound(key);
+         n > 0 && iter != accessor_.end(); ++iter, --n) {
+      sum += *iter;
+    }
+    return sum;
+  }
+
+ private:
+  ConcurrentSkipListAdapter::List::Accessor accessor_;
+};
+
+// The teaching skiplist from simple_skiplsit.cpp.  It stores ints and only
+// offers insert/search/remove.
+class SimpleSkipListAdapter {
+ public:
+  static const bool kOrdered = false;
+  static const bool kThreadSafe = false;
+
+  explicit SimpleSkipListAdapter(uint64_t expected_keys)
+      : list_(MaxLevelFor(expected_keys), 0.5) {}
+
+  bool Insert(BenchKey key) {
+    int k = static_cast<int>(key);
+    if (list_.search(k)) {
+      return false;
+    }
+    list_.insert(k);
+    return true;
+  }
+
+  bool Contains(BenchKey key) { return list_.search(static_cast<int>(key)); }
+
+  bool Erase(BenchKey key) {
+    int k = static_cast<int>(key);
+    if (!list_.search(k)) {
+      return false;
+    }
+    list_.remove(k);
+    return true;
+  }
+
+  bool Seek(BenchKey, BenchKey*) { return false; }
+  uint64_t Scan(BenchKey, uint64_t) { return 0; }
+  uint64_t ScanAll() { return 0; }
+
+ private:
+  static int MaxLevelFor(uint64_t n) {
+    int level = static_cast<int>(std::ceil(std::log2(n < 2 ? 2.0 : double(n))));
+    return level < 4 ? 4 : level;
+  }
+
+  ::SkipList list_;
+};
+
+class StdSetAdapter {
+ public:
+  static const bool kOrdered = true;
+  static const bool kThreadSafe = false;
+
+  bool Insert(BenchKey key) { return set_.insert(key).second; }
+  bool Contains(BenchKey key) { return set_.find(key) != set_.end(); }
+  bool Erase(BenchKey key) { return set_.erase(key) != 0; }
+
+  bool Seek(BenchKey key, BenchKey* found) {
+    auto iter = set_.lower_bound(key);
+    if (iter == set_.end()) {
+      return false;
+    }
+    *found = *iter;
+    return true;
+  }
+
+  uint64_t Scan(BenchKey key, uint64_t n) {
+    uint64_t sum = 0;
+    for (auto iter = set_.lower_bound(key); n > 0 && iter != set_.end();
+         ++iter, --n) {
+      sum += *iter;
+    }
+    return sum;
+  }
+
+  uint64_t ScanAll() {
+    uint64_t sum = 0;
+    for (BenchKey key : set_) {
+      sum += key;
+    }
+    return sum;
+  }
+
+  size_t size() { return set_.size(); }
+
+ private:
+  std::set<BenchKey> set_;
+};
+
+}  // namespace bench
+}  // namespace skiplist
+}  // namespace utility
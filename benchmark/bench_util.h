@@ -0,0 +1,303 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * @brief benchmark公共工具：命令行参数、计时、堆内存统计和结果输出
+ */
+
+namespace utility {
+namespace skiplist {
+namespace bench {
+
+// Parses "--name=value" style flags.  Unknown flags are kept so that every
+// benchmark can pick the ones it understands, Unknown() lists the rest.
+class Flags {
+ public:
+  Flags(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+      std::string arg(argv[i]);
+      if (arg.compare(0, 2, "--") != 0) {
+        stray_.push_back(arg);
+        continue;
+      }
+      size_t eq = arg.find('=');
+      if (eq == std::string::npos) {
+        values_[arg.substr(2)] = "true";
+      } else {
+        values_[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+      }
+    }
+  }
+
+  bool Has(const std::string& name) const {
+    return values_.find(name) != values_.end();
+  }
+
+  std::string GetString(const std::string& name,
+                        const std::string& def) const {
+    auto it = values_.find(name);
+    return it == values_.end() ? def : it->second;
+  }
+
+  uint64_t GetInt(const std::string& name, uint64_t def) const {
+    auto it = values_.find(name);
+    return it == values_.end() ? def : ParseCount(it->second);
+  }
+
+  double GetDouble(const std::string& name, double def) const {
+    auto it = values_.find(name);
+    return it == values_.end() ? def : std::strtod(it->second.c_str(), nullptr);
+  }
+
+  bool GetBool(const std::string& name, bool def) const {
+    auto it = values_.find(name);
+    if (it == values_.end()) {
+      return def;
+    }
+    return it->second == "true" || it->second == "1" || it->second == "yes";
+  }
+
+  // Flags given that are not in known, and arguments without the leading
+  // "--", for tools that refuse to run with a misspelled option.
+  std::vector<std::string> Unknown(
+      const std::vector<std::string>& known) const {
+    std::vector<std::string> result(stray_);
+    for (const auto& entry : values_) {
+      if (std::find(known.begin(), known.end(), entry.first) == known.end()) {
+        result.push_back("--" + entry.first);
+      }
+    }
+    return result;
+  }
+
+  // Comma separated list, e.g. "--sizes=1K,1M,100M".
+  std::vector<std::string> GetList(const std::string& name,
+                                   const std::string& def) const {
+    std::vector<std::string> result;
+    std::string value = GetString(name, def);
+    size_t start = 0;
+    while (start <= value.size()) {
+      size_t end = value.find(',', start);
+      if (end == std::string::npos) {
+        end = value.size();
+      }
+      if (end > start) {
+        result.push_back(value.substr(start, end - start));
+      }
+      start = end + 1;
+    }
+    return result;
+  }
+
+  // Accepts plain numbers and the K/M/G suffixes (powers of 1000).
+  static uint64_t ParseCount(const std::string& s) {
+    char* end = nullptr;
+    double v = std::strtod(s.c_str(), &end);
+    if (end != nullptr) {
+      switch (*end) {
+        case 'k': case 'K': v *= 1e3; break;
+        case 'm': case 'M': v *= 1e6; break;
+        case 'g': case 'G': v *= 1e9; break;
+        default: break;
+      }
+    }
+    return static_cast<uint64_t>(v);
+  }
+
+ private:
+  std::map<std::string, std::string> values_;
+  std::vector<std::string> stray_;
+};
+
+inline bool ListContains(const std::vector<std::string>& list,
+                         const std::string& name) {
+  return list.empty() ||
+         std::find(list.begin(), list.end(), "all") != list.end() ||
+         std::find(list.begin(), list.end(), name) != list.end();
+}
+
+class Timer {
+ public:
+  Timer() : start_(std::chrono::steady_clock::now()) {}
+
+  void Reset() { start_ = std::chrono::steady_clock::now(); }
+
+  uint64_t ElapsedNanos() const {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_)
+            .count());
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Bytes currently handed out by the process heap, including malloc headers.
+// Returns 0 when the C library cannot tell us.
+inline size_t HeapBytesInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+  struct mallinfo info = mallinfo();
+  return static_cast<size_t>(static_cast<unsigned int>(info.uordblks)) +
+         static_cast<size_t>(static_cast<unsigned int>(info.hblkhd));
+#else
+  return 0;
+#endif
+}
+
+// Pins the calling thread to one cpu, wrapping around when there are more
+// threads than cpus.  Returns false where affinity is not supported.
+inline bool PinThreadToCpu(int index) {
+#if defined(__linux__)
+  int cpus = static_cast<int>(std::thread::hardware_concurrency());
+  if (cpus <= 0) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(index % cpus, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)index;
+  return false;
+#endif
+}
+
+// Thread counts 1, 2, 4, ... up to and including maxThreads.
+inline std::vector<int> ThreadSweep(int maxThreads) {
+  std::vector<int> result;
+  for (int t = 1; t < maxThreads; t *= 2) {
+    result.push_back(t);
+  }
+  result.push_back(maxThreads < 1 ? 1 : maxThreads);
+  return result;
+}
+
+// Runs fn(threadIndex) on `threads` threads that are released together, and
+// returns the wall time from the release until the last one finishes.
+template <typename Fn>
+uint64_t RunParallel(int threads, bool pin, Fn fn) {
+  std::atomic<int> ready(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      if (pin) {
+        PinThreadToCpu(t);
+      }
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      fn(t);
+    });
+  }
+  while (ready.load() != threads) {
+    std::this_thread::yield();
+  }
+  Timer timer;
+  go.store(true, std::memory_order_release);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return timer.ElapsedNanos();
+}
+
+// Prevents the optimizer from dropping a computed value.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const T* sink;
+  sink = &value;
+#endif
+}
+
+// n distinct odd keys in random order: 1, 3, 5, ..., 2n-1.  Odd keys leave
+// the even numbers free for lookups that have to miss or seek.
+inline std::vector<uint64_t> ShuffledKeys(uint64_t n, uint64_t seed) {
+  std::vector<uint64_t> keys(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    keys[i] = 2 * i + 1;
+  }
+  std::mt19937_64 rng(seed);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  return keys;
+}
+
+inline std::string FormatCount(uint64_t n) {
+  char buf[32];
+  if (n >= 1000000000 && n % 1000000000 == 0) {
+    snprintf(buf, sizeof(buf), "%lluG", (unsigned long long)(n / 1000000000));
+  } else if (n >= 1000000 && n % 1000000 == 0) {
+    snprintf(buf, sizeof(buf), "%lluM", (unsigned long long)(n / 1000000));
+  } else if (n >= 1000 && n % 1000 == 0) {
+    snprintf(buf, sizeof(buf), "%lluK", (unsigned long long)(n / 1000));
+  } else {
+    snprintf(buf, sizeof(buf), "%llu", (unsigned long long)n);
+  }
+  return buf;
+}
+
+struct Result {
+  std::string impl;
+  std::string op;
+  uint64_t keys;      // size of the list the operation ran against
+  uint64_t ops;       // number of timed operations
+  uint64_t nanos;     // total wall time
+  double bytesPerKey; // < 0 when not measured
+
+  double NanosPerOp() const {
+    return ops == 0 ? 0.0 : static_cast<double>(nanos) / ops;
+  }
+  double OpsPerSec() const {
+    return nanos == 0 ? 0.0 : ops * 1e9 / static_cast<double>(nanos);
+  }
+};
+
+inline void PrintHeader() {
+  printf("%-16s %-8s %8s %12s %10s %14s %10s\n", "impl", "op", "keys", "ops",
+         "ns/op", "ops/s", "bytes/key");
+}
+
+inline void PrintResult(const Result& r) {
+  char bytes[32];
+  if (r.bytesPerKey < 0) {
+    snprintf(bytes, sizeof(bytes), "-");
+  } else {
+    snprintf(bytes, sizeof(bytes), "%.1f", r.bytesPerKey);
+  }
+  printf("%-16s %-8s %8s %12llu %10.1f %14.0f %10s\n", r.impl.c_str(),
+         r.op.c_str(), FormatCount(r.keys).c_str(), (unsigned long long)r.ops,
+         r.NanosPerOp(), r.OpsPerSec(), bytes);
+  fflush(stdout);
+}
+
+}  // namespace bench
+}  // namespace skiplist
+}  // namespace utility
@@ -0,0 +1,362 @@
+// Lock microbenchmark: MicroSpinLock against the alternatives in
+// lock_policies.h and std::mutex, standalone and as the ConcurrentSkipList
+// node lock.
+//
+// Usage:
+//   lock_bench [--locks=all] [--phases=all] [--max-threads=N]
+//              [--threads=1,2,4,...] [--ops=10M] [--millis=200] [--cs=0]
+//              [--keys=100K] [--hot-keys=16] [--pin=true]
+//
+//   --locks   any of: micro, ticket, mcs, futex, mutex
+//   --phases  any of: uncontended, contended, skiplist
+//
+// uncontended  one thread, --ops lock/unlock pairs on a private lock.
+// contended    every thread hammers the same lock for --millis ms and holds
+//              it for --cs pause instructions each time.
+// skiplist     ConcurrentSkipList<BenchKey, ..., Lock> preloaded with --keys
+//              odd keys; every thread alternates addOrGetData and remove of
+//              the even keys below 2 * --hot-keys for --millis ms, so all
+//              writers fight over the locks of the same few preds.
+//
+// The contended runs report acquire latency percentiles (lock() call to
+// return, steady_clock overhead included) and fairness over the per-thread
+// acquisition counts: Jain's index (sum x)^2 / (n * sum x^2), 1.0 when every
+// thread got the same share, and the min/max share ratio.  The skiplist
+// runs measure throughput with the bare lock, then run again with a timing
+// wrapper around lock() for the latency columns.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "adapters.h"
+#include "bench_util.h"
+#include "concurrent-skiplist/latency_histogram.h"
+#include "lock_policies.h"
+
+using namespace utility::skiplist::bench;
+using utility::skiplist::ConcurrentSkipList;
+using utility::skiplist::LatencySnapshot;
+using utility::skiplist::MicroSpinLock;
+using utility::skiplist::SysAllocator;
+using utility::skiplist::detail::LatencyHistogram;
+using utility::skiplist::detail::SkipListNode;
+
+namespace {
+
+struct Config {
+  std::vector<std::string> locks;
+  std::vector<int> threads;
+  uint64_t ops;
+  uint64_t millis;
+  uint64_t cs;
+  uint64_t keys;
+  uint64_t hotKeys;
+  bool pin;
+};
+
+template <typename Lock>
+struct Tag {};
+
+// Runs fn(name, Tag<Lock>()) for every selected lock.
+template <typename Fn>
+void ForEachLock(const Config& config, Fn& fn) {
+  if (ListContains(config.locks, "micro")) {
+    fn("micro", Tag<MicroSpinLock>());
+  }
+  if (ListContains(config.locks, "ticket")) {
+    fn("ticket", Tag<TicketLock>());
+  }
+  if (ListContains(config.locks, "mcs")) {
+    fn("mcs", Tag<MCSLock>());
+  }
+  if (ListContains(config.locks, "futex")) {
+    fn("futex", Tag<FutexLock>());
+  }
+  if (ListContains(config.locks, "mutex")) {
+    fn("mutex", Tag<std::mutex>());
+  }
+}
+
+// Histogram the calling thread records lock() latencies into, nullptr when
+// not measuring.
+LatencyHistogram*& CurrentHistogram() {
+  static thread_local LatencyHistogram* histogram = nullptr;
+  return histogram;
+}
+
+// Lock with the same layout as Lock whose lock() is timed into
+// CurrentHistogram().
+template <typename Lock>
+struct TimedLock : Lock {
+  void lock() {
+    LatencyHistogram* histogram = CurrentHistogram();
+    if (histogram == nullptr) {
+      Lock::lock();
+      return;
+    }
+    Timer timer;
+    Lock::lock();
+    histogram->record(timer.ElapsedNanos());
+  }
+};
+
+struct Fairness {
+  double jain;
+  double minMax;
+};
+
+Fairness ComputeFairness(const std::vector<uint64_t>& counts) {
+  double sum = 0;
+  double squares = 0;
+  uint64_t lo = counts.empty() ? 0 : counts[0];
+  uint64_t hi = lo;
+  for (uint64_t c : counts) {
+    sum += c;
+    squares += double(c) * c;
+    lo = std::min(lo, c);
+    hi = std::max(hi, c);
+  }
+  Fairness f;
+  f.jain = squares > 0 ? sum * sum / (counts.size() * squares) : 1.0;
+  f.minMax = hi > 0 ? double(lo) / hi : 1.0;
+  return f;
+}
+
+LatencySnapshot MergeHistograms(
+    const std::vector<std::unique_ptr<LatencyHistogram>>& histograms) {
+  LatencyHistogram merged;
+  for (const auto& h : histograms) {
+    merged.merge(*h);
+  }
+  return merged.snapshot();
+}
+
+void PrintContendedHeader(const char* title) {
+  printf("\n%s\n%-8s %7s %6s %14s %9s %9s %10s %8s %8s\n", title, "lock",
+         "threads", "bytes", "ops/s", "acq p50", "acq p99", "acq max",
+         "jain", "min/max");
+}
+
+void PrintContendedRow(const char* name, int threads, size_t bytes,
+                       double rate, const LatencySnapshot& acquire,
+                       const Fairness& fairness) {
+  printf("%-8s %7d %6zu %14.0f %9llu %9llu %10llu %8.3f %8.3f\n", name,
+         threads, bytes, rate, (unsigned long long)acquire.p50,
+         (unsigned long long)acquire.p99, (unsigned long long)acquire.max,
+         fairness.jain, fairness.minMax);
+  fflush(stdout);
+}
+
+struct UncontendedPhase {
+  const Config& config;
+
+  template <typename Lock>
+  void operator()(const char* name, Tag<Lock>) {
+    Lock lock{};
+    uint64_t sum = 0;
+    Timer timer;
+    for (uint64_t i = 0; i < config.ops; ++i) {
+      lock.lock();
+      sum += i;
+      lock.unlock();
+    }
+    uint64_t nanos = timer.ElapsedNanos();
+    DoNotOptimize(sum);
+    printf("%-8s %6zu %10.2f\n", name, sizeof(Lock),
+           config.ops ? double(nanos) / config.ops : 0.0);
+    fflush(stdout);
+  }
+};
+
+struct ContendedPhase {
+  const Config& config;
+  int threads;
+
+  template <typename Lock>
+  void operator()(const char* name, Tag<Lock>) {
+    TimedLock<Lock> lock{};
+    uint64_t shared = 0;
+    std::vector<uint64_t> counts(threads, 0);
+    std::vector<std::unique_ptr<LatencyHistogram>> histograms;
+    for (int t = 0; t < threads; ++t) {
+      histograms.emplace_back(new LatencyHistogram());
+    }
+    const uint64_t deadline = config.millis * 1000000;
+    uint64_t nanos = RunParallel(threads, config.pin, [&](int t) {
+      CurrentHistogram() = histograms[t].get();
+      Timer timer;
+      uint64_t n = 0;
+      do {
+        for (int i = 0; i < 64; ++i, ++n) {
+          lock.lock();
+          ++shared;
+          for (uint64_t k = 0; k < config.cs; ++k) {
+            utility::skiplist::detail::asm_volatile_pause();
+          }
+          lock.unlock();
+        }
+      } while (timer.ElapsedNanos() < deadline);
+      counts[t] = n;
+      CurrentHistogram() = nullptr;
+    });
+    DoNotOptimize(shared);
+    uint64_t total = 0;
+    for (uint64_t c : counts) {
+      total += c;
+    }
+    PrintContendedRow(name, threads, sizeof(Lock), total * 1e9 / nanos,
+                      MergeHistograms(histograms), ComputeFairness(counts));
+  }
+};
+
+struct SkipListPhase {
+  const Config& config;
+  int threads;
+
+  // Runs the hot-key churn for --millis ms, returns ops/s and fills the
+  // per-thread op counts.  Threads record lock latency when histograms is
+  // not empty (and Lock is a TimedLock).
+  template <typename List>
+  double Churn(List* list, std::vector<uint64_t>* counts,
+               std::vector<std::unique_ptr<LatencyHistogram>>* histograms) {
+    const uint64_t deadline = config.millis * 1000000;
+    const uint64_t hot = std::max<uint64_t>(1, config.hotKeys);
+    uint64_t nanos = RunParallel(threads, config.pin, [&](int t) {
+      typename List::Accessor accessor(list);
+      if (!histograms->empty()) {
+        CurrentHistogram() = (*histograms)[t].get();
+      }
+      std::mt19937_64 rng(1000 + t);
+      Timer timer;
+      uint64_t n = 0;
+      do {
+        for (int i = 0; i < 64; ++i, ++n) {
+          BenchKey key = 2 * (rng() % hot);
+          if (n % 2 == 0) {
+            accessor.addOrGetData(key);
+          } else {
+            accessor.remove(key);
+          }
+        }
+      } while (timer.ElapsedNanos() < deadline);
+      (*counts)[t] = n;
+      CurrentHistogram() = nullptr;
+    });
+    uint64_t total = 0;
+    for (uint64_t c : *counts) {
+      total += c;
+    }
+    return total * 1e9 / nanos;
+  }
+
+  template <typename List>
+  void Preload(List* list) {
+    typename List::Accessor accessor(list);
+    for (BenchKey key : ShuffledKeys(config.keys, 7)) {
+      accessor.add(key);
+    }
+  }
+
+  template <typename Lock>
+  void operator()(const char* name, Tag<Lock>) {
+    typedef ConcurrentSkipList<BenchKey, std::less<BenchKey>,
+                               SysAllocator<char>, 24, Lock>
+        List;
+    typedef ConcurrentSkipList<BenchKey, std::less<BenchKey>,
+                               SysAllocator<char>, 24, TimedLock<Lock>>
+        TimedList;
+
+    std::vector<uint64_t> counts(threads, 0);
+    std::vector<std::unique_ptr<LatencyHistogram>> none;
+    double rate;
+    typename List::Stats stats;
+    {
+      List list(1);
+      Preload(&list);
+      list.resetStats();
+      rate = Churn(&list, &counts, &none);
+      stats = list.stats();
+    }
+
+    std::vector<uint64_t> timedCounts(threads, 0);
+    std::vector<std::unique_ptr<LatencyHistogram>> histograms;
+    for (int t = 0; t < threads; ++t) {
+      histograms.emplace_back(new LatencyHistogram());
+    }
+    {
+      TimedList list(1);
+      Preload(&list);
+      Churn(&list, &timedCounts, &histograms);
+    }
+
+    PrintContendedRow(name, threads,
+                      SkipListNode<BenchKey, Lock>::allocSize(1), rate,
+                      MergeHistograms(histograms), ComputeFairness(counts));
+    printf("%-8s %7s retries add=%llu remove=%llu lock_invalid=%llu\n", "",
+           "", (unsigned long long)stats.addRetries,
+           (unsigned long long)stats.removeRetries,
+           (unsigned long long)stats.lockValidationFailures);
+    fflush(stdout);
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Flags flags(argc, argv);
+  Config config;
+  config.locks = flags.GetList("locks", "all");
+  int maxThreads = static_cast<int>(flags.GetInt(
+      "max-threads", std::max(1u, std::thread::hardware_concurrency())));
+  if (flags.Has("threads")) {
+    for (const auto& t : flags.GetList("threads", "")) {
+      config.threads.push_back(static_cast<int>(Flags::ParseCount(t)));
+    }
+  } else {
+    config.threads = ThreadSweep(maxThreads);
+  }
+  config.ops = flags.GetInt("ops", 10000000);
+  config.millis = flags.GetInt("millis", 200);
+  config.cs = flags.GetInt("cs", 0);
+  config.keys = flags.GetInt("keys", 100000);
+  config.hotKeys = flags.GetInt("hot-keys", 16);
+  config.pin = flags.GetBool("pin", true);
+  std::vector<std::string> phases = flags.GetList("phases", "all");
+
+  if (ListContains(phases, "uncontended")) {
+    printf("uncontended: %s lock/unlock pairs\n%-8s %6s %10s\n",
+           FormatCount(config.ops).c_str(), "lock", "bytes", "ns/pair");
+    UncontendedPhase phase = {config};
+    ForEachLock(config, phase);
+  }
+
+  if (ListContains(phases, "contended")) {
+    char title[128];
+    snprintf(title, sizeof(title),
+             "contended: one lock, cs=%llu pauses, %llu ms per cell",
+             (unsigned long long)config.cs,
+             (unsigned long long)config.millis);
+    PrintContendedHeader(title);
+    for (int threads : config.threads) {
+      ContendedPhase phase = {config, threads};
+      ForEachLock(config, phase);
+    }
+  }
+
+  if (ListContains(phases, "skiplist")) {
+    char title[160];
+    snprintf(title, sizeof(title),
+             "skiplist: add/remove of %llu hot keys in %s keys, %llu ms per "
+             "cell (bytes = height-1 node)",
+             (unsigned long long)config.hotKeys,
+             FormatCount(config.keys).c_str(),
+             (unsigned long long)config.millis);
+    PrintContendedHeader(title);
+    for (int threads : config.threads) {
+      SkipListPhase phase = {config, threads};
+      ForEachLock(config, phase);
+    }
+  }
+  return 0;
+}
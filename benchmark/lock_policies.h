@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <thread>
+#endif
+
+#include "concurrent-skiplist/microspinlock.h"
+#include "concurrent-skiplist/sleeper.h"
+
+/**
+ * @brief 可替换MicroSpinLock的节点锁：ticket锁、MCS队列锁、基于futex的挂起锁
+ *
+ * 都满足ConcurrentSkipList的NodeLock要求：可默认构造、值初始化即为未加锁状态，
+ * 提供lock()/unlock()。自旋等待统一使用detail::Sleeper，与MicroSpinLock的退避
+ * 策略一致，只比较排队方式本身的差异。
+ */
+
+namespace utility {
+namespace skiplist {
+namespace bench {
+
+// FIFO spinlock: take a ticket, wait until it is served.  4 bytes.
+class TicketLock {
+ public:
+  TicketLock() : next_(0), serving_(0) {}
+
+  TicketLock(const TicketLock&) = delete;
+  TicketLock& operator=(const TicketLock&) = delete;
+
+  void lock() noexcept {
+    uint16_t ticket = next_.fetch_add(1, std::memory_order_relaxed);
+    if (serving_.load(std::memory_order_acquire) == ticket) {
+      return;
+    }
+    detail::Sleeper sleeper;
+    while (serving_.load(std::memory_order_acquire) != ticket) {
+      sleeper.wait();
+    }
+  }
+
+  bool try_lock() noexcept {
+    uint16_t serving = serving_.load(std::memory_order_relaxed);
+    uint16_t expected = serving;
+    return next_.compare_exchange_strong(expected, uint16_t(serving + 1),
+                                         std::memory_order_acquire);
+  }
+
+  void unlock() noexcept {
+    serving_.store(uint16_t(serving_.load(std::memory_order_relaxed) + 1),
+                   std::memory_order_release);
+  }
+
+ private:
+  std::atomic<uint16_t> next_;
+  std::atomic<uint16_t> serving_;
+};
+
+// MCS queue lock: every waiter spins on its own queue node, so a release
+// touches one remote cache line only.  A thread may hold several MCS locks
+// at once (add and remove lock up to MAX_HEIGHT preds), so the queue nodes
+// come from a small thread-local pool and the holder's node is remembered in
+// the lock itself.  16 bytes.
+class MCSLock {
+ public:
+  MCSLock() : tail_(nullptr), holder_(nullptr) {}
+
+  MCSLock(const MCSLock&) = delete;
+  MCSLock& operator=(const MCSLock&) = delete;
+
+  void lock() noexcept {
+    QNode* node = acquireQNode();
+    node->next.store(nullptr, std::memory_order_relaxed);
+    node->locked.store(true, std::memory_order_relaxed);
+    QNode* prev = tail_.exchange(node, std::memory_order_acq_rel);
+    if (prev != nullptr) {
+      prev->next.store(node, std::memory_order_release);
+      detail::Sleeper sleeper;
+      while (node->locked.load(std::memory_order_acquire)) {
+        sleeper.wait();
+      }
+    }
+    holder_ = node;
+  }
+
+  bool try_lock() noexcept {
+    QNode* node = acquireQNode();
+    node->next.store(nullptr, std::memory_order_relaxed);
+    QNode* expected = nullptr;
+    if (!tail_.compare_exchange_strong(expected, node,
+                                       std::memory_order_acquire)) {
+      releaseQNode(node);
+      return false;
+    }
+    holder_ = node;
+    return true;
+  }
+
+  void unlock() noexcept {
+    QNode* node = holder_;
+    QNode* next = node->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      QNode* expected = node;
+      if (tail_.compare_exchange_strong(expected, nullptr,
+                                        std::memory_order_release)) {
+        releaseQNode(node);
+        return;
+      }
+      // a successor swapped itself in but has not linked to us yet
+      detail::Sleeper sleeper;
+      while ((next = node->next.load(std::memory_order_acquire)) == nullptr) {
+        sleeper.wait();
+      }
+    }
+    next->locked.store(false, std::memory_order_release);
+    releaseQNode(node);
+  }
+
+ private:
+  struct alignas(64) QNode {
+    QNode() : next(nullptr), locked(false), inUse(false) {}
+
+    std::atomic<QNode*> next;
+    std::atomic<bool> locked;
+    bool inUse;
+  };
+
+  // Locks one thread can hold at the same time.
+  static const int kMaxHeld = 64;
+
+  struct QNodePool {
+    QNode nodes[kMaxHeld];
+  };
+
+  static QNodePool& pool() {
+    static thread_local QNodePool pool;
+    return pool;
+  }
+
+  static QNode* acquireQNode() {
+    QNodePool& p = pool();
+    for (int i = 0; i < kMaxHeld; ++i) {
+      if (!p.nodes[i].inUse) {
+        p.nodes[i].inUse = true;
+        return &p.nodes[i];
+      }
+    }
+    assert(false && "MCSLock: too many locks held by one thread");
+    return nullptr;
+  }
+
+  // Called by the thread that acquired the node: ownership of a QNode never
+  // leaves its thread, only its `locked` flag is written by the predecessor.
+  static void releaseQNode(QNode* node) { node->inUse = false; }
+
+  std::atomic<QNode*> tail_;
+  QNode* holder_; // only read and written by the lock holder
+};
+
+// Drepper's three-state mutex ("Futexes Are Tricky", mutex #3): 0 free,
+// 1 locked, 2 locked with waiters.  Waiters park in the kernel instead of
+// spinning.  4 bytes.
+class FutexLock {
+ public:
+  FutexLock() : state_(0) {}
+
+  FutexLock(const FutexLock&) = delete;
+  FutexLock& operator=(const FutexLock&) = delete;
+
+  void lock() noexcept {
+    uint32_t c = 0;
+    if (state_.compare_exchange_strong(c, 1, std::memory_order_acquire)) {
+      return;
+    }
+    if (c != 2) {
+      c = state_.exchange(2, std::memory_order_acquire);
+    }
+    while (c != 0) {
+      futexWait(2);
+      c = state_.exchange(2, std::memory_order_acquire);
+    }
+  }
+
+  bool try_lock() noexcept {
+    uint32_t c = 0;
+    return state_.compare_exchange_strong(c, 1, std::memory_order_acquire);
+  }
+
+  void unlock() noexcept {
+    if (state_.fetch_sub(1, std::memory_order_release) != 1) {
+      state_.store(0, std::memory_order_release);
+      futexWake(1);
+    }
+  }
+
+ private:
+  void futexWait(uint32_t expected) noexcept {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state_),
+            FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    (void)expected;
+    std::this_thread::yield();
+#endif
+  }
+
+  void futexWake(int count) noexcept {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state_),
+            FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+    (void)count;
+#endif
+  }
+
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                "futex word must be a plain 32-bit integer");
+  std::atomic<uint32_t> state_;
+};
+
+} // namespace bench
+} // namespace skiplist
+} // namespace utility
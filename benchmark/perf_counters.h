@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief 基于perf_event_open的硬件性能计数器，用于benchmark按操作统计cache/TLB miss
+ *
+ * 非Linux平台或内核不允许（perf_event_paranoid、容器限制）时Available()返回false，
+ * 各benchmark的--perf选项随之不输出任何内容。
+ */
+
+namespace utility {
+namespace skiplist {
+namespace bench {
+
+enum PerfEvent {
+  kPerfCycles = 0,
+  kPerfInstructions,
+  kPerfL1dMisses,     // L1 data cache read misses
+  kPerfLlcMisses,     // last level cache read misses
+  kPerfDtlbMisses,    // data TLB read misses
+  kPerfBranchMisses,
+  kNumPerfEvents,
+};
+
+inline const char* PerfEventName(int event) {
+  static const char* const kNames[kNumPerfEvents] = {
+      "cycles", "instr", "l1d-miss", "llc-miss", "dtlb-miss", "br-miss"};
+  return kNames[event];
+}
+
+// Counter values between PerfCounters::Start() and Stop(), scaled up when
+// the kernel had to multiplex the counters.  valid[i] is false for events
+// the cpu or the kernel would not count.
+struct PerfSample {
+  double values[kNumPerfEvents];
+  bool valid[kNumPerfEvents];
+
+  PerfSample() {
+    for (int i = 0; i < kNumPerfEvents; ++i) {
+      values[i] = 0;
+      valid[i] = false;
+    }
+  }
+};
+
+// Counts user-space events of the calling thread and of every thread it
+// starts while the counters run (RunParallel workers included, their counts
+// are folded in when they are joined).  Every event is opened on its own so
+// that one the PMU lacks does not take the others down.
+class PerfCounters {
+ public:
+  PerfCounters() {
+    for (int i = 0; i < kNumPerfEvents; ++i) {
+      fds_[i] = -1;
+    }
+#if defined(__linux__)
+    static const struct {
+      uint32_t type;
+      uint64_t config;
+    } kEvents[kNumPerfEvents] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_L1D)},
+        {PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_LL)},
+        {PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_DTLB)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    };
+    for (int i = 0; i < kNumPerfEvents; ++i) {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = kEvents[i].type;
+      attr.config = kEvents[i].config;
+      attr.disabled = 1;
+      attr.inherit = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format =
+          PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds_[i] = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+      if (fds_[i] < 0 && error_.empty()) {
+        error_ = std::string(PerfEventName(i)) + ": " + strerror(errno);
+      }
+    }
+#else
+    error_ = "perf_event_open is Linux only";
+#endif
+  }
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (int i = 0; i < kNumPerfEvents; ++i) {
+      if (fds_[i] >= 0) {
+        close(fds_[i]);
+      }
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  // True when at least one event could be opened.
+  bool Available() const {
+    for (int i = 0; i < kNumPerfEvents; ++i) {
+      if (fds_[i] >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Why the first event that failed could not be opened, empty if none did.
+  const std::string& Error() const { return error_; }
+
+  void Start() {
+#if defined(__linux__)
+    for (int i = 0; i < kNumPerfEvents; ++i) {
+      if (fds_[i] >= 0) {
+        ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  PerfSample Stop() {
+    PerfSample sample;
+#if defined(__linux__)
+    for (int i = 0; i < kNumPerfEvents; ++i) {
+      if (fds_[i] >= 0) {
+        ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+    for (int i = 0; i < kNumPerfEvents; ++i) {
+      uint64_t data[3];  // value, time enabled, time running
+      if (fds_[i] < 0 || read(fds_[i], data, sizeof(data)) != sizeof(data) ||
+          data[2] == 0) {
+        continue;
+      }
+      sample.values[i] = static_cast<double>(data[0]) * data[1] / data[2];
+      sample.valid[i] = true;
+    }
+#endif
+    return sample;
+  }
+
+ private:
+#if defined(__linux__)
+  static uint64_t CacheReadMiss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  }
+#endif
+
+  int fds_[kNumPerfEvents];
+  std::string error_;
+};
+
+// One indented line of per-operation counts under a result row, e.g.
+//   perf: cycles/op=812.4 ipc=0.41 l1d-miss/op=23.1 llc-miss/op=9.8 ...
+inline void PrintPerf(const PerfSample& s, uint64_t ops) {
+  if (ops == 0) {
+    return;
+  }
+  bool any = false;
+  printf("%16s perf:", "");
+  for (int i = 0; i < kNumPerfEvents; ++i) {
+    if (s.valid[i]) {
+      printf(" %s/op=%.2f", PerfEventName(i), s.values[i] / ops);
+      any = true;
+    }
+    if (i == kPerfInstructions && s.valid[kPerfCycles] &&
+        s.valid[kPerfInstructions] && s.values[kPerfCycles] > 0) {
+      printf(" ipc=%.2f", s.values[kPerfInstructions] / s.values[kPerfCycles]);
+    }
+  }
+  printf("%s\n", any ? "" : " no counters");
+  fflush(stdout);
+}
+
+}  // namespace bench
+}  // namespace skiplist
+}  // namespace utility
@@ -0,0 +1,328 @@
+// Thread-scalability matrix for ConcurrentSkipList.
+//
+// Usage:
+//   scalability_bench [--max-threads=N] [--threads=1,2,4,...]
+//                     [--reads=100,95,50,0] [--keys=1M] [--ops=1M]
+//                     [--micro=all] [--pin=true] [--seed=N]
+//
+//   --ops    operations per thread for every cell of the matrix.
+//   --micro  any of: accessor, add, find, remove, skipper, leveldb-mutex,
+//            leveldb-cas
+//
+// Mixed runs preload --keys keys out of a key space twice that size; the
+// write share is split evenly between add and remove of random keys, so the
+// list stays at the same size.  Every thread keeps one Accessor.
+//
+// The micro runs time one operation at a time with all threads doing the
+// same thing: building and dropping an Accessor, addOrGetData of fresh keys,
+// find of existing keys, remove of the keys just added, and Skipper::to over
+// an ascending sequence of targets.  leveldb-mutex and leveldb-cas insert
+// the same fresh keys into a leveldb SkipList preloaded with the same keys,
+// through Insert() under one writer mutex and through the lock-free
+// InsertConcurrently() respectively; both allocate from a TLSF pool behind a
+// SynchronizedAllocator.
+//
+// Two tables are printed for each: throughput, and scaling efficiency
+// throughput(t) / (t * throughput(1)).  The mixed runs are followed by the
+// list's contention counters (ConcurrentSkipList::stats()) for every cell.
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "adapters.h"
+#include "bench_util.h"
+
+using namespace utility::skiplist::bench;
+
+namespace {
+
+typedef ConcurrentSkipListAdapter::List List;
+typedef utility::skiplist::SkipList<
+    BenchKey, LevelDBComparator,
+    utility::skiplist::SynchronizedAllocator<utility::skiplist::TLSFAllocator>>
+    LevelDBList;
+
+struct Config {
+  std::vector<int> threads;
+  uint64_t keys;
+  uint64_t ops;
+  bool pin;
+  uint64_t seed;
+};
+
+std::shared_ptr<List> Preload(uint64_t n, uint64_t seed) {
+  std::shared_ptr<List> list = List::createInstance(1);
+  List::Accessor accessor(list);
+  for (BenchKey key : ShuffledKeys(n, seed)) {
+    accessor.add(key);
+  }
+  return list;
+}
+
+void PrintTables(const std::string& title,
+                 const std::vector<std::string>& columns,
+                 const std::vector<int>& threads,
+                 const std::vector<std::vector<double>>& rates) {
+  printf("\n%s: ops/s\n%8s", title.c_str(), "threads");
+  for (const auto& c : columns) {
+    printf(" %14s", c.c_str());
+  }
+  printf("\n");
+  for (size_t i = 0; i < threads.size(); ++i) {
+    printf("%8d", threads[i]);
+    for (size_t j = 0; j < columns.size(); ++j) {
+      printf(" %14.0f", rates[i][j]);
+    }
+    printf("\n");
+  }
+
+  printf("\n%s: scaling efficiency\n%8s", title.c_str(), "threads");
+  for (const auto& c : columns) {
+    printf(" %14s", c.c_str());
+  }
+  printf("\n");
+  for (size_t i = 0; i < threads.size(); ++i) {
+    printf("%8d", threads[i]);
+    for (size_t j = 0; j < columns.size(); ++j) {
+      double base = rates[0][j] * threads[i] / threads[0];
+      printf(" %13.0f%%", base > 0 ? 100.0 * rates[i][j] / base : 0.0);
+    }
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
+double RunMixed(const Config& config, int threads, int readPercent,
+                List::Stats* stats) {
+  std::shared_ptr<List> list = Preload(config.keys, config.seed);
+  list->resetStats();
+  const uint64_t space = 2 * config.keys;
+  uint64_t nanos = RunParallel(threads, config.pin, [&](int t) {
+    List::Accessor accessor(list);
+    std::mt19937_64 rng(config.seed + 7919 * (t + 1));
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < config.ops; ++i) {
+      uint64_t r = rng();
+      BenchKey key = (r >> 8) % space;
+      int dice = static_cast<int>(r % 100);
+      if (dice < readPercent) {
+        found += accessor.contains(key);
+      } else if ((dice - readPercent) % 2 == 0) {
+        found += accessor.add(key);
+      } else {
+        found += accessor.remove(key);
+      }
+    }
+    DoNotOptimize(found);
+  });
+  *stats = list->stats();
+  return config.ops * threads * 1e9 / nanos;
+}
+
+void PrintStats(const std::vector<int>& threads,
+                const std::vector<std::string>& reads,
+                const std::vector<std::vector<List::Stats>>& stats) {
+  printf("\nmixed: contention counters\n%8s %6s %12s %12s %12s %10s %12s "
+         "%12s %14s %10s\n",
+         "threads", "read%", "addRetry", "removeRetry", "lockInvalid",
+         "grow", "growCasLost", "lockWaits", "lockSpins", "lockSleeps");
+  for (size_t i = 0; i < threads.size(); ++i) {
+    for (size_t j = 0; j < reads.size(); ++j) {
+      const List::Stats& s = stats[i][j];
+      printf("%8d %6s %12llu %12llu %12llu %10llu %12llu %12llu %14llu "
+             "%10llu\n",
+             threads[i], reads[j].c_str(), (unsigned long long)s.addRetries,
+             (unsigned long long)s.removeRetries,
+             (unsigned long long)s.lockValidationFailures,
+             (unsigned long long)s.growHeights,
+             (unsigned long long)s.growHeightCasFailures,
+             (unsigned long long)s.sleeperWaits,
+             (unsigned long long)s.sleeperSpins,
+             (unsigned long long)s.sleeperSleeps);
+    }
+  }
+  fflush(stdout);
+}
+
+// Fresh keys for thread t: even keys never collide with the preloaded odd
+// keys, and the stride keeps threads apart.
+inline BenchKey FreshKey(int t, int threads, uint64_t i) {
+  return 2 * (i * threads + t);
+}
+
+// The odd keys below 2 * n, like Preload().
+std::unique_ptr<LevelDBList> PreloadLevelDB(uint64_t n) {
+  std::vector<BenchKey> keys(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    keys[i] = 2 * i + 1;
+  }
+  return std::unique_ptr<LevelDBList>(
+      new LevelDBList(LevelDBComparator(), keys.begin(), keys.end(),
+                      utility::skiplist::TLSFAllocator::Owning()));
+}
+
+std::vector<double> RunMicro(const Config& config, int threads,
+                             const std::vector<std::string>& micro) {
+  std::vector<double> rates;
+  const double totalOps = static_cast<double>(config.ops) * threads;
+  std::shared_ptr<List> list = Preload(config.keys, config.seed);
+
+  if (ListContains(micro, "accessor")) {
+    uint64_t nanos = RunParallel(threads, config.pin, [&](int) {
+      for (uint64_t i = 0; i < config.ops; ++i) {
+        List::Accessor accessor(list);
+        DoNotOptimize(accessor);
+      }
+    });
+    rates.push_back(totalOps * 1e9 / nanos);
+  }
+
+  if (ListContains(micro, "add")) {
+    uint64_t nanos = RunParallel(threads, config.pin, [&](int t) {
+      List::Accessor accessor(list);
+      for (uint64_t i = 0; i < config.ops; ++i) {
+        accessor.addOrGetData(FreshKey(t, threads, i));
+      }
+    });
+    rates.push_back(totalOps * 1e9 / nanos);
+  }
+
+  if (ListContains(micro, "find")) {
+    uint64_t nanos = RunParallel(threads, config.pin, [&](int t) {
+      List::Accessor accessor(list);
+      std::mt19937_64 rng(config.seed + t);
+      uint64_t found = 0;
+      for (uint64_t i = 0; i < config.ops; ++i) {
+        found += accessor.find(2 * (rng() % config.keys) + 1) !=
+            accessor.end();
+      }
+      DoNotOptimize(found);
+    });
+    rates.push_back(totalOps * 1e9 / nanos);
+  }
+
+  if (ListContains(micro, "remove")) {
+    // removes what "add" inserted, or misses if it did not run
+    uint64_t nanos = RunParallel(threads, config.pin, [&](int t) {
+      List::Accessor accessor(list);
+      for (uint64_t i = 0; i < config.ops; ++i) {
+        accessor.remove(FreshKey(t, threads, i));
+      }
+    });
+    rates.push_back(totalOps * 1e9 / nanos);
+  }
+
+  if (ListContains(micro, "skipper")) {
+    std::vector<std::vector<BenchKey>> targets(threads);
+    for (int t = 0; t < threads; ++t) {
+      std::mt19937_64 rng(config.seed + 31 * t);
+      targets[t].resize(config.ops);
+      for (auto& target : targets[t]) {
+        target = rng() % (2 * config.keys);
+      }
+      std::sort(targets[t].begin(), targets[t].end());
+    }
+    uint64_t nanos = RunParallel(threads, config.pin, [&](int t) {
+      List::Skipper skipper(list);
+      uint64_t found = 0;
+      for (BenchKey target : targets[t]) {
+        found += skipper.to(target);
+      }
+      DoNotOptimize(found);
+    });
+    rates.push_back(totalOps * 1e9 / nanos);
+  }
+
+  if (ListContains(micro, "leveldb-mutex")) {
+    std::unique_ptr<LevelDBList> leveldb = PreloadLevelDB(config.keys);
+    std::mutex mutex;
+    uint64_t nanos = RunParallel(threads, config.pin, [&](int t) {
+      for (uint64_t i = 0; i < config.ops; ++i) {
+        std::lock_guard<std::mutex> lock(mutex);
+        leveldb->Insert(FreshKey(t, threads, i));
+      }
+    });
+    rates.push_back(totalOps * 1e9 / nanos);
+  }
+
+  if (ListContains(micro, "leveldb-cas")) {
+    std::unique_ptr<LevelDBList> leveldb = PreloadLevelDB(config.keys);
+    // InsertConcurrently() never grows the head, size it like the mutex
+    // run ends up.
+    leveldb->Reserve(config.keys + config.ops * threads);
+    uint64_t nanos = RunParallel(threads, config.pin, [&](int t) {
+      for (uint64_t i = 0; i < config.ops; ++i) {
+        leveldb->InsertConcurrently(FreshKey(t, threads, i));
+      }
+    });
+    rates.push_back(totalOps * 1e9 / nanos);
+  }
+  return rates;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Flags flags(argc, argv);
+  Config config;
+  int maxThreads = static_cast<int>(flags.GetInt(
+      "max-threads", std::max(1u, std::thread::hardware_concurrency())));
+  if (flags.Has("threads")) {
+    for (const auto& t : flags.GetList("threads", "")) {
+      config.threads.push_back(static_cast<int>(Flags::ParseCount(t)));
+    }
+  } else {
+    config.threads = ThreadSweep(maxThreads);
+  }
+  config.keys = flags.GetInt("keys", 1000000);
+  config.ops = flags.GetInt("ops", 1000000);
+  config.pin = flags.GetBool("pin", true);
+  config.seed = flags.GetInt("seed", 301);
+  std::vector<std::string> reads = flags.GetList("reads", "100,95,50,0");
+  std::vector<std::string> micro = flags.GetList("micro", "all");
+
+  printf("ConcurrentSkipList scalability: keys=%s ops/thread=%s pin=%s\n",
+         FormatCount(config.keys).c_str(), FormatCount(config.ops).c_str(),
+         config.pin ? "true" : "false");
+
+  if (!reads.empty() && reads[0] != "none") {
+    std::vector<std::string> columns;
+    for (const auto& r : reads) {
+      columns.push_back(r + "% read");
+    }
+    std::vector<std::vector<double>> rates;
+    std::vector<std::vector<List::Stats>> stats;
+    for (int threads : config.threads) {
+      std::vector<double> row;
+      std::vector<List::Stats> statsRow(reads.size());
+      for (size_t j = 0; j < reads.size(); ++j) {
+        row.push_back(RunMixed(config, threads,
+                               static_cast<int>(Flags::ParseCount(reads[j])),
+                               &statsRow[j]));
+      }
+      rates.push_back(row);
+      stats.push_back(statsRow);
+    }
+    PrintTables("mixed", columns, config.threads, rates);
+    PrintStats(config.threads, reads, stats);
+  }
+
+  if (!micro.empty() && micro[0] != "none") {
+    std::vector<std::string> columns;
+    const char* names[] = {"accessor", "add", "find", "remove", "skipper",
+                           "leveldb-mutex", "leveldb-cas"};
+    for (const char* name : names) {
+      if (ListContains(micro, name)) {
+        columns.push_back(name);
+      }
+    }
+    std::vector<std::vector<double>> rates;
+    for (int threads : config.threads) {
+      rates.push_back(RunMicro(config, threads, micro));
+    }
+    PrintTables("micro", columns, config.threads, rates);
+  }
+  return 0;
+}
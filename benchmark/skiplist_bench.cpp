@@ -0,0 +1,591 @@
+// Cross-implementation benchmark for the skiplists in this repo.
+//
+// Usage:
+//   skiplist_bench [--sizes=1K,10K,100K,1M,10M,100M] [--impls=all]
+//                  [--ops=all] [--seed=N] [--batch=1000] [--perf] [--help]
+//
+//   --sizes  key counts to run, 1K up to 100M by default.  The 100M run needs
+//            tens of GB with every impl, pick smaller sizes or fewer impls
+//            on smaller machines.
+//   --impls  any of: leveldb-malloc, leveldb-tlsf, leveldb-arena, leveldb-prev,
+//            concurrent, simple, std-set
+//   --ops    any of: insert, lookup, miss, seek, scan, rscan, delete, shape,
+//            traverse, clear, batch
+//   --perf   print hardware counters per op under every result (cycles, IPC,
+//            L1d/LLC/dTLB read misses, branch misses), see perf_counters.h.
+//
+// "traverse" looks up every key of the concurrent list twice, once stepping
+// down first (findNodeDownRight, what find() uses) and once stepping right
+// first (findNodeRightDown), reported as find-dr and find-rd.  The leveldb
+// lookup op is its FindGreaterOrEqual.
+//
+// "shape" prints the structural stats of the leveldb and concurrent lists
+// (level histogram against the ideal one, search path length, comparator
+// calls) after loading, and again after deleting 3 out of 4 keys.  For
+// leveldb-tlsf it also prints the TLSF pool occupancy (used/free bytes, free
+// block histogram, external fragmentation) at both points and once more after
+// the deleted keys were inserted again.  Both lists also report their own
+// memory accounting (node bytes, head, allocator overhead, nodes still held
+// by the NodeRecycler) next to the shape.
+//
+// leveldb-prev is leveldb-tlsf with backward links on level 0.  "rscan"
+// walks the leveldb lists from the last key to the first with
+// Iterator::Prev(), a search per step unless the list has backward links.
+//
+// "batch" refills the emptied leveldb lists in write groups of --batch keys
+// taken in random order and sorted within the group, once with one Insert()
+// per key (ins-sorted) and once with InsertBatch() per group (ins-batch),
+// then rebuilds them from all keys in sorted order with Assign() (build).
+//
+// "clear" reloads the leveldb lists after the delete phase and times
+// SkipList::Clear(), which releases the whole TLSF pool or arena at once and
+// walks the nodes only on the malloc path.  ns/op is per key dropped.
+//
+// Keys are distinct odd uint64s inserted in random order; "miss" and "seek"
+// use even keys, so they never hit an existing entry.  Every op is reported
+// as ns/op and ops/s; bytes/key is the heap growth after the insert phase
+// (malloc headers and TLSF pool slack included) divided by the key count.
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "adapters.h"
+#include "bench_util.h"
+#include "perf_counters.h"
+
+using namespace utility::skiplist::bench;
+
+namespace {
+
+struct Config {
+  std::vector<std::string> ops;
+  uint64_t seed;
+  uint64_t batch;
+  PerfCounters* perf;  // nullptr unless --perf
+};
+
+// Every timed phase runs between BeginPhase and EndPhase, and is reported
+// with Report.
+void BeginPhase(const Config& config, Timer* timer) {
+  if (config.perf != nullptr) {
+    config.perf->Start();
+  }
+  timer->Reset();
+}
+
+void EndPhase(const Config& config, const Timer& timer, Result* r,
+              PerfSample* perf) {
+  r->nanos = timer.ElapsedNanos();
+  if (config.perf != nullptr) {
+    *perf = config.perf->Stop();
+  }
+}
+
+void Report(const Config& config, const Result& r, const PerfSample& perf) {
+  PrintResult(r);
+  if (config.perf != nullptr) {
+    PrintPerf(perf, r.ops);
+  }
+}
+
+// The rscan, batch, clear, shape and memory ops run on every adapter over a
+// leveldb SkipList, whatever its allocator, links or height policy, and are
+// no-ops for the others.  Dispatched on the adapter's List type.
+template <typename List>
+struct IsLevelDBList : std::false_type {};
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+struct IsLevelDBList<utility::skiplist::SkipList<
+    Key, Comparator, Allocator, PrevLinks, Indexed, HeightPolicy>>
+    : std::true_type {};
+
+template <typename T>
+struct VoidType {
+  typedef void type;
+};
+
+template <typename Adapter, typename = void>
+struct HasLevelDBList : std::false_type {};
+
+template <typename Adapter>
+struct HasLevelDBList<Adapter,
+                      typename VoidType<typename Adapter::List>::type>
+    : IsLevelDBList<typename Adapter::List> {};
+
+template <typename Adapter>
+void RunTraversals(Adapter*, const std::vector<BenchKey>&, const Config&,
+                   Result*) {}
+
+void RunTraversals(ConcurrentSkipListAdapter* adapter,
+                   const std::vector<BenchKey>& keys, const Config& config,
+                   Result* r) {
+  typedef ConcurrentSkipListAdapter::List List;
+  List::Accessor accessor = adapter->accessor();
+  const List* list = accessor.skiplist();
+  const List::Traversal traversals[] = {List::Traversal::kDownRight,
+                                        List::Traversal::kRightDown};
+  const char* names[] = {"find-dr", "find-rd"};
+  for (int i = 0; i < 2; ++i) {
+    uint64_t hits = 0;
+    Timer timer;
+    PerfSample perf;
+    BeginPhase(config, &timer);
+    for (BenchKey key : keys) {
+      hits += list->findWith(traversals[i], key) != nullptr;
+    }
+    EndPhase(config, timer, r, &perf);
+    DoNotOptimize(hits);
+    r->op = names[i];
+    Report(config, *r, perf);
+  }
+}
+
+template <typename Adapter>
+void RunReverseScan(Adapter*, const Config&, Result*, std::false_type) {}
+
+template <typename Adapter>
+void RunReverseScan(Adapter* adapter, const Config& config, Result* r,
+                    std::true_type) {
+  Timer timer;
+  PerfSample perf;
+  BeginPhase(config, &timer);
+  uint64_t sum = adapter->ReverseScanAll();
+  EndPhase(config, timer, r, &perf);
+  DoNotOptimize(sum);
+  r->op = "rscan";
+  Report(config, *r, perf);
+}
+
+template <typename Adapter>
+void RunReverseScan(Adapter* adapter, const Config& config, Result* r) {
+  RunReverseScan(adapter, config, r, HasLevelDBList<Adapter>());
+}
+
+template <typename Adapter>
+void RunClear(Adapter*, const std::vector<BenchKey>&, const Config&, Result*,
+              std::false_type) {}
+
+template <typename Adapter>
+void RunClear(Adapter* adapter, const std::vector<BenchKey>& keys,
+              const Config& config, Result* r, std::true_type) {
+  for (BenchKey key : keys) {
+    adapter->Insert(key);
+  }
+  Timer timer;
+  PerfSample perf;
+  BeginPhase(config, &timer);
+  adapter->Clear();
+  EndPhase(config, timer, r, &perf);
+  r->op = "clear";
+  Report(config, *r, perf);
+}
+
+template <typename Adapter>
+void RunClear(Adapter* adapter, const std::vector<BenchKey>& keys,
+              const Config& config, Result* r) {
+  RunClear(adapter, keys, config, r, HasLevelDBList<Adapter>());
+}
+
+template <typename Adapter>
+void RunBatch(Adapter*, const std::vector<BenchKey>&, const Config&, Result*,
+              std::false_type) {}
+
+template <typename Adapter>
+void RunBatch(Adapter* adapter, const std::vector<BenchKey>& keys,
+              const Config& config, Result* r, std::true_type) {
+  std::vector<BenchKey> groups(keys);
+  const size_t batch = std::max<uint64_t>(config.batch, 1);
+  for (size_t i = 0; i < groups.size(); i += batch) {
+    std::sort(groups.begin() + i,
+              groups.begin() + std::min(i + batch, groups.size()));
+  }
+  const char* names[] = {"ins-sorted", "ins-batch"};
+  for (int mode = 0; mode < 2; ++mode) {
+    adapter->Clear();
+    Timer timer;
+    PerfSample perf;
+    BeginPhase(config, &timer);
+    for (size_t i = 0; i < groups.size(); i += batch) {
+      const BenchKey* first = groups.data() + i;
+      const BenchKey* last = groups.data() + std::min(i + batch, groups.size());
+      if (mode == 0) {
+        for (const BenchKey* key = first; key != last; ++key) {
+          adapter->Insert(*key);
+        }
+      } else {
+        adapter->InsertBatch(first, last);
+      }
+    }
+    EndPhase(config, timer, r, &perf);
+    r->op = names[mode];
+    Report(config, *r, perf);
+  }
+
+  std::vector<BenchKey> sorted(keys);
+  std::sort(sorted.begin(), sorted.end());
+  Timer timer;
+  PerfSample perf;
+  BeginPhase(config, &timer);
+  adapter->Assign(sorted.data(), sorted.data() + sorted.size());
+  EndPhase(config, timer, r, &perf);
+  r->op = "build";
+  Report(config, *r, perf);
+  adapter->Clear();
+}
+
+template <typename Adapter>
+void RunBatch(Adapter* adapter, const std::vector<BenchKey>& keys,
+              const Config& config, Result* r) {
+  RunBatch(adapter, keys, config, r, HasLevelDBList<Adapter>());
+}
+
+void PrintShapeLine(const std::string& name, const char* when, size_t nodes,
+                    int height, double distance, double path, size_t maxPath,
+                    double comparisons, const std::vector<size_t>& levels) {
+  printf("%-16s shape(%s): nodes=%zu height=%d distance=%.3f "
+         "path=%.1f max_path=%zu cmp=%.1f levels=",
+         name.c_str(), when, nodes, height, distance, path, maxPath,
+         comparisons);
+  for (size_t i = 0; i < levels.size() && levels[i] != 0; ++i) {
+    printf("%s%zu", i ? "/" : "", levels[i]);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+template <typename Adapter>
+void PrintShape(const std::string&, Adapter*, const char*, std::false_type) {}
+
+template <typename Adapter>
+void PrintShape(const std::string& name, Adapter* adapter, const char* when,
+                std::true_type) {
+  std::lock_guard<std::mutex> g(adapter->mutex());
+  typename Adapter::List::StructureStats s =
+      adapter->list()->GetStructureStats(16);
+  PrintShapeLine(name, when, s.num_nodes, s.max_height, s.shape_distance,
+                 s.avg_search_path, s.max_search_path, s.avg_comparisons,
+                 s.level_nodes);
+}
+
+template <typename Adapter>
+void PrintShape(const std::string& name, Adapter* adapter, const char* when) {
+  PrintShape(name, adapter, when, HasLevelDBList<Adapter>());
+}
+
+void PrintShape(const std::string& name, ConcurrentSkipListAdapter* adapter,
+                const char* when) {
+  ConcurrentSkipListAdapter::List::StructureStats s =
+      adapter->accessor().structureStats(16);
+  PrintShapeLine(name, when, s.nodes, s.height, s.shapeDistance,
+                 s.avgSearchPath, s.maxSearchPath, s.avgComparisons,
+                 s.levelNodes);
+}
+
+void PrintMemoryLine(const std::string& name, const char* when, size_t nodes,
+                     size_t nodeBytes, size_t headBytes, size_t overhead,
+                     size_t recyclerBytes, size_t total) {
+  printf("%-16s memory(%s): nodes=%zu node_bytes=%zu head=%zu overhead=%zu "
+         "recycler=%zu total=%zu bytes/key=%.1f\n",
+         name.c_str(), when, nodes, nodeBytes, headBytes, overhead,
+         recyclerBytes, total, nodes ? double(total) / nodes : 0.0);
+  fflush(stdout);
+}
+
+template <typename Adapter>
+void PrintMemory(const std::string&, Adapter*, const char*, std::false_type) {}
+
+template <typename Adapter>
+void PrintMemory(const std::string& name, Adapter* adapter, const char* when,
+                 std::true_type) {
+  std::lock_guard<std::mutex> g(adapter->mutex());
+  typename Adapter::List::MemoryUsage m = adapter->list()->GetMemoryUsage();
+  PrintMemoryLine(name, when, m.num_nodes, m.node_bytes, m.head_bytes,
+                  m.allocator_overhead, m.retired_bytes, m.total_bytes);
+}
+
+template <typename Adapter>
+void PrintMemory(const std::string& name, Adapter* adapter, const char* when) {
+  PrintMemory(name, adapter, when, HasLevelDBList<Adapter>());
+}
+
+void PrintMemory(const std::string& name, ConcurrentSkipListAdapter* adapter,
+                 const char* when) {
+  ConcurrentSkipListAdapter::List::MemoryUsage m =
+      adapter->accessor().memoryUsage();
+  PrintMemoryLine(name, when, m.nodes, m.nodeBytes, m.headBytes,
+                  m.allocatorOverhead, m.recyclerBytes, m.totalBytes);
+}
+
+template <typename Adapter>
+void PrintPool(const std::string&, Adapter*, const char*) {}
+
+void PrintPool(const std::string& name, LevelDBSkipListAdapter* adapter,
+               const char* when) {
+  if (adapter->pool() == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> g(adapter->mutex());
+  printf("%-16s pool(%s): ", name.c_str(), when);
+  adapter->pool()->printStats();
+  fflush(stdout);
+}
+
+// heapBaseline is sampled before the adapter is constructed, so that memory
+// reserved up front (e.g. the first TLSF pool) is charged to the keys.
+template <typename Adapter>
+void RunOps(const std::string& name, Adapter* adapter,
+            std::vector<BenchKey>* order, const std::vector<BenchKey>& probes,
+            size_t heapBaseline, const Config& config) {
+  std::vector<BenchKey>& keys = *order;
+  const uint64_t n = keys.size();
+  Result r;
+  r.impl = name;
+  r.keys = n;
+  r.ops = n;
+  r.bytesPerKey = -1;
+
+  // The list must be populated for every other op, so insert always runs
+  // and is only reported when asked for.
+  Timer timer;
+  PerfSample perf;
+  BeginPhase(config, &timer);
+  for (BenchKey key : keys) {
+    adapter->Insert(key);
+  }
+  EndPhase(config, timer, &r, &perf);
+  size_t heapAfter = HeapBytesInUse();
+  double bytesPerKey = heapAfter > heapBaseline
+      ? static_cast<double>(heapAfter - heapBaseline) / n
+      : -1;
+  if (ListContains(config.ops, "insert")) {
+    r.op = "insert";
+    r.bytesPerKey = bytesPerKey;
+    Report(config, r, perf);
+  }
+  r.bytesPerKey = -1;
+
+  std::shuffle(keys.begin(), keys.end(), std::mt19937_64(config.seed + 2));
+
+  if (ListContains(config.ops, "lookup")) {
+    uint64_t hits = 0;
+    BeginPhase(config, &timer);
+    for (BenchKey key : keys) {
+      hits += adapter->Contains(key);
+    }
+    EndPhase(config, timer, &r, &perf);
+    DoNotOptimize(hits);
+    r.op = "lookup";
+    Report(config, r, perf);
+  }
+
+  if (ListContains(config.ops, "miss")) {
+    uint64_t hits = 0;
+    BeginPhase(config, &timer);
+    for (BenchKey key : probes) {
+      hits += adapter->Contains(key);
+    }
+    EndPhase(config, timer, &r, &perf);
+    DoNotOptimize(hits);
+    r.op = "miss";
+    Report(config, r, perf);
+  }
+
+  if (Adapter::kOrdered && ListContains(config.ops, "seek")) {
+    BenchKey sum = 0;
+    BeginPhase(config, &timer);
+    for (BenchKey key : probes) {
+      BenchKey found = 0;
+      adapter->Seek(key, &found);
+      sum += found;
+    }
+    EndPhase(config, timer, &r, &perf);
+    DoNotOptimize(sum);
+    r.op = "seek";
+    Report(config, r, perf);
+  }
+
+  if (Adapter::kOrdered && ListContains(config.ops, "scan")) {
+    BeginPhase(config, &timer);
+    uint64_t sum = adapter->ScanAll();
+    EndPhase(config, timer, &r, &perf);
+    DoNotOptimize(sum);
+    r.op = "scan";
+    Report(config, r, perf);
+  }
+
+  if (ListContains(config.ops, "rscan")) {
+    RunReverseScan(adapter, config, &r);
+  }
+
+  if (ListContains(config.ops, "traverse")) {
+    RunTraversals(adapter, keys, config, &r);
+  }
+
+  if (ListContains(config.ops, "shape")) {
+    PrintShape(name, adapter, "loaded");
+    PrintMemory(name, adapter, "loaded");
+    PrintPool(name, adapter, "loaded");
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (i % 4 != 0) {
+        adapter->Erase(keys[i]);
+      }
+    }
+    PrintShape(name, adapter, "after 75% deleted");
+    PrintMemory(name, adapter, "after 75% deleted");
+    PrintPool(name, adapter, "after 75% deleted");
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (i % 4 != 0) {
+        adapter->Insert(keys[i]);
+      }
+    }
+    PrintPool(name, adapter, "reinserted");
+  }
+
+  // Always drain the list, some implementations never free on destruction.
+  BeginPhase(config, &timer);
+  for (BenchKey key : keys) {
+    adapter->Erase(key);
+  }
+  EndPhase(config, timer, &r, &perf);
+  if (ListContains(config.ops, "delete")) {
+    r.op = "delete";
+    Report(config, r, perf);
+  }
+
+  if (ListContains(config.ops, "batch")) {
+    RunBatch(adapter, keys, config, &r);
+  }
+
+  if (ListContains(config.ops, "clear")) {
+    RunClear(adapter, keys, config, &r);
+  }
+}
+
+const char kUsage[] =
+    "usage: skiplist_bench [--sizes=1K,10K,100K,1M,10M,100M] [--impls=all]\n"
+    "                      [--ops=all] [--seed=N] [--batch=1000] [--perf]\n"
+    "  --impls  any of: leveldb-malloc, leveldb-tlsf, leveldb-arena,\n"
+    "           leveldb-prev, concurrent, simple, std-set\n"
+    "  --ops    any of: insert, lookup, miss, seek, scan, rscan, delete,\n"
+    "           shape, traverse, clear, batch\n";
+
+// Returns the first entry of list that is neither "all" nor in known, or an
+// empty string.
+std::string UnknownName(const std::vector<std::string>& list,
+                        const std::vector<std::string>& known) {
+  for (const std::string& name : list) {
+    if (name != "all" &&
+        std::find(known.begin(), known.end(), name) == known.end()) {
+      return name;
+    }
+  }
+  return std::string();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Flags flags(argc, argv);
+  if (flags.Has("help")) {
+    printf("%s", kUsage);
+    return 0;
+  }
+  std::vector<std::string> unknown =
+      flags.Unknown({"sizes", "impls", "ops", "seed", "batch", "perf"});
+  if (!unknown.empty()) {
+    fprintf(stderr, "unknown argument %s\n%s", unknown[0].c_str(), kUsage);
+    return 1;
+  }
+  std::vector<std::string> sizes =
+      flags.GetList("sizes", "1K,10K,100K,1M,10M,100M");
+  std::vector<std::string> impls = flags.GetList("impls", "all");
+
+  Config config;
+  config.ops = flags.GetList("ops", "all");
+  std::string bad = UnknownName(
+      impls, {"leveldb-malloc", "leveldb-tlsf", "leveldb-arena",
+              "leveldb-prev", "concurrent", "simple", "std-set"});
+  if (bad.empty()) {
+    bad = UnknownName(config.ops,
+                      {"insert", "lookup", "miss", "seek", "scan", "rscan",
+                       "delete", "shape", "traverse", "clear", "batch"});
+  }
+  if (!bad.empty()) {
+    fprintf(stderr, "unknown impl or op %s\n%s", bad.c_str(), kUsage);
+    return 1;
+  }
+  config.seed = flags.GetInt("seed", 301);
+  config.batch = flags.GetInt("batch", 1000);
+  config.perf = nullptr;
+  std::unique_ptr<PerfCounters> perf;
+  if (flags.GetBool("perf", false)) {
+    perf.reset(new PerfCounters());
+    if (perf->Available()) {
+      config.perf = perf.get();
+    } else {
+      printf("perf counters unavailable (%s), --perf ignored\n",
+             perf->Error().c_str());
+    }
+  }
+
+  PrintHeader();
+  for (const std::string& size : sizes) {
+    uint64_t n = Flags::ParseCount(size);
+    if (n == 0) {
+      continue;
+    }
+    const std::vector<BenchKey> keys = ShuffledKeys(n, config.seed);
+    std::vector<BenchKey> probes = ShuffledKeys(n, config.seed + 1);
+    for (auto& probe : probes) {
+      probe -= 1;  // even keys, never present
+    }
+
+    if (ListContains(impls, "leveldb-malloc")) {
+      std::vector<BenchKey> order(keys);
+      size_t heap = HeapBytesInUse();
+      LevelDBSkipListAdapter adapter(false);
+      RunOps("leveldb-malloc", &adapter, &order, probes, heap, config);
+    }
+    if (ListContains(impls, "leveldb-tlsf")) {
+      std::vector<BenchKey> order(keys);
+      size_t heap = HeapBytesInUse();
+      LevelDBSkipListAdapter adapter(true);
+      RunOps("leveldb-tlsf", &adapter, &order, probes, heap, config);
+    }
+    if (ListContains(impls, "leveldb-arena")) {
+      std::vector<BenchKey> order(keys);
+      size_t heap = HeapBytesInUse();
+      LevelDBArenaSkipListAdapter adapter;
+      RunOps("leveldb-arena", &adapter, &order, probes, heap, config);
+    }
+    if (ListContains(impls, "leveldb-prev")) {
+      std::vector<BenchKey> order(keys);
+      size_t heap = HeapBytesInUse();
+      LevelDBPrevSkipListAdapter adapter;
+      RunOps("leveldb-prev", &adapter, &order, probes, heap, config);
+    }
+    if (ListContains(impls, "concurrent")) {
+      std::vector<BenchKey> order(keys);
+      size_t heap = HeapBytesInUse();
+      ConcurrentSkipListAdapter adapter;
+      RunOps("concurrent", &adapter, &order, probes, heap, config);
+    }
+    if (ListContains(impls, "simple")) {
+      std::vector<BenchKey> order(keys);
+      size_t heap = HeapBytesInUse();
+      SimpleSkipListAdapter adapter(n);
+      RunOps("simple", &adapter, &order, probes, heap, config);
+    }
+    if (ListContains(impls, "std-set")) {
+      std::vector<BenchKey> order(keys);
+      size_t heap = HeapBytesInUse();
+      StdSetAdapter adapter;
+      RunOps("std-set", &adapter, &order, probes, heap, config);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,464 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "adapters.h"
+
+/**
+ * @brief 操作trace的录制与读取：记录每次操作的类型、key、线程、时间戳和结果
+ *
+ * 文件格式：8字节magic "SLTRACE1"，之后是若干chunk，每个chunk只包含一个线程的记录：
+ *   varint thread, varint count, count条记录
+ * 每条记录：
+ *   varint 距该线程上一条记录的纳秒数, 1字节 (op << 1 | result), varint key,
+ *   op为kScan时再跟一个varint扫描长度
+ * 同一线程的记录按时间顺序出现，不同线程的chunk交错存放，回放时每个线程独立按序执行。
+ * key以uint64_t记录，要求key类型可以无损转换为uint64_t。
+ */
+
+namespace utility {
+namespace skiplist {
+namespace bench {
+
+enum class TraceOp : uint8_t {
+  kInsert = 0,
+  kErase = 1,
+  kContains = 2,
+  kSeek = 3,
+  kScan = 4,
+};
+
+static const int kNumTraceOps = 5;
+
+inline const char* TraceOpName(TraceOp op) {
+  switch (op) {
+    case TraceOp::kInsert: return "insert";
+    case TraceOp::kErase: return "erase";
+    case TraceOp::kContains: return "contains";
+    case TraceOp::kSeek: return "seek";
+    case TraceOp::kScan: return "scan";
+  }
+  return "unknown";
+}
+
+struct TraceEvent {
+  uint64_t nanos;  // since the TraceWriter was created
+  uint64_t key;
+  uint64_t scanLength;  // kScan only
+  TraceOp op;
+  bool result;  // what the operation returned; for kScan, whether it found
+                // anything
+};
+
+static const char kTraceMagic[8] = {'S', 'L', 'T', 'R', 'A', 'C', 'E', '1'};
+
+// Thread-safe trace recorder.  Every recording thread fills its own buffer
+// and appends it to the file as one chunk when it is full, so threads only
+// meet on the file lock once per kChunkEvents events.  Close() (or the
+// destructor) flushes the rest; no thread may record after that.
+class TraceWriter {
+ public:
+  static const size_t kChunkEvents = 4096;
+
+  explicit TraceWriter(const std::string& path)
+      : id_(NextId()),
+        file_(fopen(path.c_str(), "wb")),
+        start_(std::chrono::steady_clock::now()) {
+    if (file_ != nullptr) {
+      fwrite(kTraceMagic, 1, sizeof(kTraceMagic), file_);
+    }
+  }
+
+  ~TraceWriter() { Close(); }
+
+  TraceWriter(const TraceWriter&) = delete;
+  TraceWriter& operator=(const TraceWriter&) = delete;
+
+  bool ok() const { return file_ != nullptr; }
+
+  void Record(TraceOp op, uint64_t key, bool result, uint64_t scanLength = 0) {
+    Buffer* buffer = LocalBuffer();
+    TraceEvent event;
+    event.nanos = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_)
+            .count());
+    event.key = key;
+    event.scanLength = scanLength;
+    event.op = op;
+    event.result = result;
+    buffer->events.push_back(event);
+    if (buffer->events.size() >= kChunkEvents) {
+      std::lock_guard<std::mutex> g(mutex_);
+      WriteChunk(buffer);
+    }
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> g(mutex_);
+    if (file_ == nullptr) {
+      return;
+    }
+    for (auto& entry : buffers_) {
+      WriteChunk(entry.second.get());
+    }
+    fclose(file_);
+    file_ = nullptr;
+  }
+
+ private:
+  struct Buffer {
+    uint32_t thread;
+    uint64_t lastNanos;
+    std::vector<TraceEvent> events;
+  };
+
+  struct Cache {
+    uint64_t id;
+    Buffer* buffer;
+  };
+
+  static uint64_t NextId() {
+    static std::atomic<uint64_t> next(1);
+    return next.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Same one-entry thread-local cache as detail::LatencyRecorder.
+  Buffer* LocalBuffer() {
+    static thread_local Cache cache = {0, nullptr};
+    if (cache.id == id_) {
+      return cache.buffer;
+    }
+    std::lock_guard<std::mutex> g(mutex_);
+    std::unique_ptr<Buffer>& buffer = buffers_[std::this_thread::get_id()];
+    if (!buffer) {
+      buffer.reset(new Buffer());
+      buffer->thread = static_cast<uint32_t>(buffers_.size() - 1);
+      buffer->lastNanos = 0;
+      buffer->events.reserve(kChunkEvents);
+    }
+    cache.id = id_;
+    cache.buffer = buffer.get();
+    return cache.buffer;
+  }
+
+  static void PutVarint(std::string* out, uint64_t v) {
+    while (v >= 0x80) {
+      out->push_back(static_cast<char>(v | 0x80));
+      v >>= 7;
+    }
+    out->push_back(static_cast<char>(v));
+  }
+
+  // REQUIRES: mutex_ held.
+  void WriteChunk(Buffer* buffer) {
+    if (buffer->events.empty() || file_ == nullptr) {
+      buffer->events.clear();
+      return;
+    }
+    std::string chunk;
+    PutVarint(&chunk, buffer->thread);
+    PutVarint(&chunk, buffer->events.size());
+    for (const TraceEvent& e : buffer->events) {
+      PutVarint(&chunk, e.nanos - buffer->lastNanos);
+      buffer->lastNanos = e.nanos;
+      chunk.push_back(static_cast<char>(
+          (static_cast<uint8_t>(e.op) << 1) | (e.result ? 1 : 0)));
+      PutVarint(&chunk, e.key);
+      if (e.op == TraceOp::kScan) {
+        PutVarint(&chunk, e.scanLength);
+      }
+    }
+    fwrite(chunk.data(), 1, chunk.size(), file_);
+    buffer->events.clear();
+  }
+
+  const uint64_t id_;
+  std::mutex mutex_;
+  FILE* file_;
+  const std::chrono::steady_clock::time_point start_;
+  std::map<std::thread::id, std::unique_ptr<Buffer>> buffers_;
+};
+
+// A whole trace in memory: threads[t] holds the events of recorded thread
+// t in the order it issued them.
+struct Trace {
+  std::vector<std::vector<TraceEvent>> threads;
+
+  uint64_t TotalEvents() const {
+    uint64_t n = 0;
+    for (const auto& t : threads) {
+      n += t.size();
+    }
+    return n;
+  }
+};
+
+// Returns false, with a reason in *error, if the file is missing, not a
+// trace, or truncated.
+inline bool ReadTrace(const std::string& path, Trace* trace,
+                      std::string* error) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  std::string data;
+  char buf[1 << 16];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+    data.append(buf, n);
+  }
+  fclose(file);
+
+  if (data.size() < sizeof(kTraceMagic) ||
+      data.compare(0, sizeof(kTraceMagic), kTraceMagic, sizeof(kTraceMagic)) !=
+          0) {
+    *error = path + " is not a skiplist trace";
+    return false;
+  }
+  size_t pos = sizeof(kTraceMagic);
+  bool truncated = false;
+  auto getVarint = [&]() -> uint64_t {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos >= data.size()) {
+        truncated = true;
+        return 0;
+      }
+      uint8_t byte = static_cast<uint8_t>(data[pos++]);
+      v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+    return v;
+  };
+
+  std::vector<uint64_t> lastNanos;
+  trace->threads.clear();
+  while (pos < data.size() && !truncated) {
+    uint64_t thread = getVarint();
+    uint64_t count = getVarint();
+    if (thread >= trace->threads.size()) {
+      trace->threads.resize(thread + 1);
+      lastNanos.resize(thread + 1, 0);
+    }
+    std::vector<TraceEvent>& events = trace->threads[thread];
+    for (uint64_t i = 0; i < count && !truncated; ++i) {
+      TraceEvent e;
+      e.nanos = lastNanos[thread] + getVarint();
+      lastNanos[thread] = e.nanos;
+      if (pos >= data.size()) {
+        truncated = true;
+        break;
+      }
+      uint8_t opAndResult = static_cast<uint8_t>(data[pos++]);
+      e.op = static_cast<TraceOp>(opAndResult >> 1);
+      e.result = (opAndResult & 1) != 0;
+      e.key = getVarint();
+      e.scanLength = e.op == TraceOp::kScan ? getVarint() : 0;
+      if (static_cast<int>(e.op) >= kNumTraceOps) {
+        *error = path + ": unknown op in trace";
+        return false;
+      }
+      events.push_back(e);
+    }
+  }
+  if (truncated) {
+    *error = path + " is truncated";
+    return false;
+  }
+  return true;
+}
+
+// Recording wrapper over a leveldb SkipList, which must be externally
+// synchronized for writers as usual.
+template <typename List>
+class TracingSkipList {
+ public:
+  TracingSkipList(List* list, TraceWriter* writer)
+      : list_(list), writer_(writer) {}
+
+  template <typename Key>
+  bool Insert(const Key& key) {
+    bool inserted = list_->Insert(key);
+    writer_->Record(TraceOp::kInsert, static_cast<uint64_t>(key), inserted);
+    return inserted;
+  }
+
+  template <typename Key>
+  bool Delete(const Key& key) {
+    bool erased = list_->Delete(key);
+    writer_->Record(TraceOp::kErase, static_cast<uint64_t>(key), erased);
+    return erased;
+  }
+
+  template <typename Key>
+  bool Contains(const Key& key) const {
+    bool found = list_->Contains(key);
+    writer_->Record(TraceOp::kContains, static_cast<uint64_t>(key), found);
+    return found;
+  }
+
+  // Positions iter at the first key >= target.
+  template <typename Key>
+  void Seek(typename List::Iterator* iter, const Key& target) const {
+    iter->Seek(target);
+    writer_->Record(TraceOp::kSeek, static_cast<uint64_t>(target),
+                    iter->Valid());
+  }
+
+ private:
+  List* list_;
+  TraceWriter* writer_;
+};
+
+// Recording wrapper over a ConcurrentSkipList::Accessor.  Like the Accessor
+// it is meant to be used by one thread.
+template <typename Accessor>
+class TracingAccessor {
+ public:
+  typedef typename Accessor::key_type key_type;
+  typedef typename Accessor::iterator iterator;
+
+  TracingAccessor(const Accessor& accessor, TraceWriter* writer)
+      : accessor_(accessor), writer_(writer) {}
+
+  bool add(const key_type& data) {
+    bool added = accessor_.add(data);
+    writer_->Record(TraceOp::kInsert, static_cast<uint64_t>(data), added);
+    return added;
+  }
+
+  std::pair<iterator, bool> insert(const key_type& data) {
+    std::pair<iterator, bool> ret = accessor_.insert(data);
+    writer_->Record(TraceOp::kInsert, static_cast<uint64_t>(data),
+                    ret.second);
+    return ret;
+  }
+
+  bool remove(const key_type& data) {
+    bool removed = accessor_.remove(data);
+    writer_->Record(TraceOp::kErase, static_cast<uint64_t>(data), removed);
+    return removed;
+  }
+
+  bool contains(const key_type& data) const {
+    bool found = accessor_.contains(data);
+    writer_->Record(TraceOp::kContains, static_cast<uint64_t>(data), found);
+    return found;
+  }
+
+  iterator find(const key_type& data) {
+    iterator iter = accessor_.find(data);
+    writer_->Record(TraceOp::kContains, static_cast<uint64_t>(data),
+                    iter != accessor_.end());
+    return iter;
+  }
+
+  iterator lower_bound(const key_type& data) {
+    iterator iter = accessor_.lower_bound(data);
+    writer_->Record(TraceOp::kSeek, static_cast<uint64_t>(data),
+                    iter != accessor_.end());
+    return iter;
+  }
+
+  iterator end() { return accessor_.end(); }
+  Accessor& accessor() { return accessor_; }
+
+ private:
+  Accessor accessor_;
+  TraceWriter* writer_;
+};
+
+// Adapter (see adapters.h) that records every operation of the adapter it
+// wraps, so any benchmark driver can produce a trace.
+template <typename Adapter>
+class TracingAdapter {
+ public:
+  static const bool kOrdered = Adapter::kOrdered;
+  static const bool kThreadSafe = Adapter::kThreadSafe;
+
+  TracingAdapter(Adapter* adapter, TraceWriter* writer)
+      : adapter_(adapter), writer_(writer) {}
+
+  bool Insert(BenchKey key) {
+    return Traced(TraceOp::kInsert, key, adapter_->Insert(key));
+  }
+  bool Contains(BenchKey key) {
+    return Traced(TraceOp::kContains, key, adapter_->Contains(key));
+  }
+  bool Erase(BenchKey key) {
+    return Traced(TraceOp::kErase, key, adapter_->Erase(key));
+  }
+  bool Seek(BenchKey key, BenchKey* found) {
+    return Traced(TraceOp::kSeek, key, adapter_->Seek(key, found));
+  }
+  uint64_t Scan(BenchKey key, uint64_t n) {
+    uint64_t sum = adapter_->Scan(key, n);
+    writer_->Record(TraceOp::kScan, key, sum != 0, n);
+    return sum;
+  }
+
+  Adapter* inner() { return adapter_; }
+  TraceWriter* writer() { return writer_; }
+
+ private:
+  bool Traced(TraceOp op, BenchKey key, bool result) {
+    writer_->Record(op, key, result);
+    return result;
+  }
+
+  Adapter* adapter_;
+  TraceWriter* writer_;
+};
+
+// Keeps the inner adapter's per-thread handle (e.g. one Accessor per
+// thread) while recording.
+template <typename Adapter>
+class ThreadHandle<TracingAdapter<Adapter>> {
+ public:
+  explicit ThreadHandle(TracingAdapter<Adapter>* adapter)
+      : inner_(adapter->inner()), writer_(adapter->writer()) {}
+
+  bool Insert(BenchKey key) {
+    return Traced(TraceOp::kInsert, key, inner_.Insert(key));
+  }
+  bool Contains(BenchKey key) {
+    return Traced(TraceOp::kContains, key, inner_.Contains(key));
+  }
+  bool Erase(BenchKey key) {
+    return Traced(TraceOp::kErase, key, inner_.Erase(key));
+  }
+  bool Seek(BenchKey key, BenchKey* found) {
+    return Traced(TraceOp::kSeek, key, inner_.Seek(key, found));
+  }
+  uint64_t Scan(BenchKey key, uint64_t n) {
+    uint64_t sum = inner_.Scan(key, n);
+    writer_->Record(TraceOp::kScan, key, sum != 0, n);
+    return sum;
+  }
+
+ private:
+  bool Traced(TraceOp op, BenchKey key, bool result) {
+    writer_->Record(op, key, result);
+    return result;
+  }
+
+  ThreadHandle<Adapter> inner_;
+  TraceWriter* writer_;
+};
+
+}  // namespace bench
+}  // namespace skiplist
+}  // namespace utility
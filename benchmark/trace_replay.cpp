@@ -0,0 +1,267 @@
+// Replays a trace recorded with TraceWriter (see trace.h) against the
+// skiplists.
+//
+// Usage:
+//   trace_replay --trace=FILE [--impls=leveldb-tlsf,concurrent]
+//                [--pacing=full|original] [--speed=1.0] [--pin]
+//
+//   --impls   any of: leveldb-malloc, leveldb-tlsf, leveldb-arena, concurrent,
+//             std-set
+//             (std-set only for traces whose threads never overlap in time)
+//   --pacing  full: every thread issues its next operation as soon as the
+//             previous one returns.  original: operations are issued at
+//             their recorded offsets from the start of the trace, divided
+//             by --speed.
+//
+// Every recorded thread is replayed on its own thread, in its recorded
+// order, against an empty list.  A thread does not start before every event
+// recorded ahead of its first one has been replayed, so phases like a
+// single-threaded load followed by a multi-threaded run stay apart.  A trace
+// that did not start from an empty list, or whose threads raced on the same
+// keys, can replay with different results; those are counted as
+// mismatches.  For each implementation the tool prints the wall time,
+// throughput, mismatches and (original pacing) how far the replay fell
+// behind schedule, then the latency of every op type.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "adapters.h"
+#include "bench_util.h"
+#include "concurrent-skiplist/latency_histogram.h"
+#include "trace.h"
+
+using namespace utility::skiplist::bench;
+using utility::skiplist::LatencySnapshot;
+using utility::skiplist::detail::LatencyHistogram;
+
+namespace {
+
+struct Config {
+  bool original;
+  double speed;
+  bool pin;
+};
+
+struct ThreadStats {
+  std::unique_ptr<LatencyHistogram> latency[kNumTraceOps];
+  uint64_t mismatches = 0;
+  uint64_t maxLagNanos = 0;
+
+  ThreadStats() {
+    for (auto& h : latency) {
+      h.reset(new LatencyHistogram());
+    }
+  }
+};
+
+template <typename Handle>
+bool Execute(Handle* handle, const TraceEvent& e) {
+  switch (e.op) {
+    case TraceOp::kInsert:
+      return handle->Insert(e.key);
+    case TraceOp::kErase:
+      return handle->Erase(e.key);
+    case TraceOp::kContains:
+      return handle->Contains(e.key);
+    case TraceOp::kSeek: {
+      BenchKey found = 0;
+      return handle->Seek(e.key, &found);
+    }
+    case TraceOp::kScan:
+      return handle->Scan(e.key, e.scanLength) != 0;
+  }
+  return false;
+}
+
+// Blocks until `deadline`, sleeping while it is far away.
+void WaitUntil(std::chrono::steady_clock::time_point deadline) {
+  for (;;) {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) {
+      return;
+    }
+    if (deadline - now > std::chrono::microseconds(100)) {
+      std::this_thread::sleep_for(deadline - now -
+                                  std::chrono::microseconds(50));
+    }
+  }
+}
+
+// True if the recorded threads ran one after another, e.g. the load phase
+// and the single worker of a ycsb_bench --threads=1 trace.  Replay() then
+// runs them one after another too, so a list that is not thread-safe can
+// replay the trace.
+bool ThreadsSerialized(const Trace& trace) {
+  std::vector<std::pair<uint64_t, uint64_t>> spans;
+  for (const auto& events : trace.threads) {
+    if (!events.empty()) {
+      spans.emplace_back(events.front().nanos, events.back().nanos);
+    }
+  }
+  std::sort(spans.begin(), spans.end());
+  for (size_t i = 1; i < spans.size(); ++i) {
+    // A thread may start while one that ended at the same time is still
+    // replaying its last event.
+    if (spans[i].first <= spans[i - 1].second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Adapter>
+void Replay(const std::string& name, Adapter* adapter, const Trace& trace,
+            const Config& config) {
+  const int threads = static_cast<int>(trace.threads.size());
+  uint64_t base = UINT64_MAX;
+  for (const auto& events : trace.threads) {
+    if (!events.empty()) {
+      base = std::min(base, events.front().nanos);
+    }
+  }
+  std::vector<ThreadStats> stats(threads);
+  // next[t] is the recorded time of the first event thread t has not
+  // replayed yet, UINT64_MAX once it is done.
+  std::unique_ptr<std::atomic<uint64_t>[]> next(
+      new std::atomic<uint64_t>[threads]);
+  for (int t = 0; t < threads; ++t) {
+    next[t].store(trace.threads[t].empty() ? UINT64_MAX
+                                           : trace.threads[t].front().nanos);
+  }
+  // The first thread to run fixes the start of the schedule for all.
+  typedef std::chrono::steady_clock Clock;
+  std::atomic<Clock::rep> startTicks(0);
+
+  uint64_t nanos = RunParallel(threads, config.pin, [&](int t) {
+    Clock::rep ticks = 0;
+    startTicks.compare_exchange_strong(
+        ticks, Clock::now().time_since_epoch().count());
+    const Clock::time_point start(Clock::duration(startTicks.load()));
+    const std::vector<TraceEvent>& events = trace.threads[t];
+    const uint64_t first = next[t].load();
+    for (int u = 0; u < threads; ++u) {
+      while (u != t && next[u].load(std::memory_order_acquire) < first) {
+        std::this_thread::yield();
+      }
+    }
+    ThreadHandle<Adapter> handle(adapter);
+    ThreadStats& s = stats[t];
+    for (size_t i = 0; i < events.size(); ++i) {
+      const TraceEvent& e = events[i];
+      if (config.original) {
+        auto due = start + std::chrono::nanoseconds(static_cast<uint64_t>(
+                               (e.nanos - base) / config.speed));
+        WaitUntil(due);
+        uint64_t lag = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - due)
+                .count());
+        s.maxLagNanos = std::max(s.maxLagNanos, lag);
+      }
+      Timer timer;
+      bool result = Execute(&handle, e);
+      s.latency[static_cast<int>(e.op)]->record(timer.ElapsedNanos());
+      s.mismatches += result != e.result;
+      next[t].store(i + 1 < events.size() ? events[i + 1].nanos : UINT64_MAX,
+                    std::memory_order_release);
+    }
+    next[t].store(UINT64_MAX, std::memory_order_release);
+  });
+
+  uint64_t mismatches = 0;
+  uint64_t maxLag = 0;
+  LatencyHistogram merged[kNumTraceOps];
+  for (const ThreadStats& s : stats) {
+    mismatches += s.mismatches;
+    maxLag = std::max(maxLag, s.maxLagNanos);
+    for (int i = 0; i < kNumTraceOps; ++i) {
+      merged[i].merge(*s.latency[i]);
+    }
+  }
+  const uint64_t events = trace.TotalEvents();
+  printf("%-16s %7d %12llu %10.1f %14.0f %10llu %12s\n", name.c_str(),
+         threads, (unsigned long long)events, nanos / 1e6,
+         events * 1e9 / nanos, (unsigned long long)mismatches,
+         config.original ? std::to_string(maxLag / 1000).c_str() : "-");
+  for (int i = 0; i < kNumTraceOps; ++i) {
+    LatencySnapshot l = merged[i].snapshot();
+    if (l.count == 0) {
+      continue;
+    }
+    printf("  %-10s %12llu %8.0f %8llu %8llu %8llu %10llu\n",
+           TraceOpName(static_cast<TraceOp>(i)), (unsigned long long)l.count,
+           l.mean, (unsigned long long)l.p50, (unsigned long long)l.p99,
+           (unsigned long long)l.p999, (unsigned long long)l.max);
+  }
+  fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Flags flags(argc, argv);
+  std::string path = flags.GetString("trace", "");
+  if (path.empty()) {
+    fprintf(stderr, "usage: trace_replay --trace=FILE [--impls=...] "
+                    "[--pacing=full|original] [--speed=1.0] [--pin]\n");
+    return 1;
+  }
+  Trace trace;
+  std::string error;
+  if (!ReadTrace(path, &trace, &error)) {
+    fprintf(stderr, "trace_replay: %s\n", error.c_str());
+    return 1;
+  }
+
+  Config config;
+  std::string pacing = flags.GetString("pacing", "full");
+  config.original = pacing == "original";
+  config.speed = flags.GetDouble("speed", 1.0);
+  if (config.speed <= 0) {
+    config.speed = 1.0;
+  }
+  config.pin = flags.GetBool("pin", false);
+  std::vector<std::string> impls =
+      flags.GetList("impls", "leveldb-tlsf,concurrent");
+
+  printf("trace %s: threads=%zu events=%llu pacing=%s", path.c_str(),
+         trace.threads.size(), (unsigned long long)trace.TotalEvents(),
+         config.original ? "original" : "full");
+  if (config.original) {
+    printf(" speed=%.2f", config.speed);
+  }
+  printf("\n%-16s %7s %12s %10s %14s %10s %12s\n", "impl", "threads",
+         "events", "wall(ms)", "ops/s", "mismatch", "max lag(us)");
+  printf("  %-10s %12s %8s %8s %8s %8s %10s\n", "latency(ns)", "count",
+         "mean", "p50", "p99", "p99.9", "max");
+
+  if (ListContains(impls, "leveldb-malloc")) {
+    LevelDBSkipListAdapter adapter(false);
+    Replay("leveldb-malloc", &adapter, trace, config);
+  }
+  if (ListContains(impls, "leveldb-tlsf")) {
+    LevelDBSkipListAdapter adapter(true);
+    Replay("leveldb-tlsf", &adapter, trace, config);
+  }
+  if (ListContains(impls, "leveldb-arena")) {
+    LevelDBArenaSkipListAdapter adapter;
+    Replay("leveldb-arena", &adapter, trace, config);
+  }
+  if (ListContains(impls, "concurrent")) {
+    ConcurrentSkipListAdapter adapter;
+    Replay("concurrent", &adapter, trace, config);
+  }
+  if (ThreadsSerialized(trace) && ListContains(impls, "std-set")) {
+    StdSetAdapter adapter;
+    Replay("std-set", &adapter, trace, config);
+  }
+  return 0;
+}
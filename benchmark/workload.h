@@ -0,0 +1,470 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "adapters.h"
+#include "bench_util.h"
+
+/**
+ * @brief YCSB风格的workload生成器
+ *
+ * 支持uniform、zipfian、latest、sequential、hotspot五种key分布，以及
+ * read/insert/update/delete/scan的任意比例组合。通过ThreadHandle驱动
+ * leveldb SkipList和ConcurrentSkipList::Accessor。
+ *
+ * 用法：
+ *   WorkloadSpec spec = WorkloadSpec::Preset('A');
+ *   WorkloadState state(spec);
+ *   LoadRecords(&adapter, spec, seed);
+ *   WorkloadResult r = RunWorkload(&adapter, spec, &state, threads, ops, seed);
+ */
+
+namespace utility {
+namespace skiplist {
+namespace bench {
+
+enum class OpType : uint8_t {
+  kRead = 0,
+  kInsert = 1,
+  kUpdate = 2,
+  kDelete = 3,
+  kScan = 4,
+};
+
+static const int kNumOpTypes = 5;
+
+inline const char* OpTypeName(OpType type) {
+  switch (type) {
+    case OpType::kRead: return "read";
+    case OpType::kInsert: return "insert";
+    case OpType::kUpdate: return "update";
+    case OpType::kDelete: return "delete";
+    case OpType::kScan: return "scan";
+  }
+  return "unknown";
+}
+
+enum class Distribution {
+  kUniform,
+  kZipfian,     // scrambled zipfian, the hot keys are spread over the space
+  kLatest,      // zipfian over insertion order, newest keys are hottest
+  kSequential,  // walks the key space in order
+  kHotspot,     // hotOpnFraction of the ops hit hotDataFraction of the keys
+};
+
+inline bool ParseDistribution(const std::string& name, Distribution* out) {
+  if (name == "uniform") {
+    *out = Distribution::kUniform;
+  } else if (name == "zipfian") {
+    *out = Distribution::kZipfian;
+  } else if (name == "latest") {
+    *out = Distribution::kLatest;
+  } else if (name == "sequential") {
+    *out = Distribution::kSequential;
+  } else if (name == "hotspot") {
+    *out = Distribution::kHotspot;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+struct Operation {
+  OpType type;
+  BenchKey key;
+  uint32_t scanLength;
+};
+
+struct WorkloadSpec {
+  WorkloadSpec()
+      : recordCount(1000000),
+        readProportion(0.5),
+        insertProportion(0),
+        updateProportion(0.5),
+        deleteProportion(0),
+        scanProportion(0),
+        distribution(Distribution::kZipfian),
+        orderedInserts(false),
+        zipfianConstant(0.99),
+        hotDataFraction(0.2),
+        hotOpnFraction(0.8),
+        maxScanLength(100) {}
+
+  uint64_t recordCount;  // keys loaded before the run
+  double readProportion;
+  double insertProportion;
+  double updateProportion;  // delete + re-insert of an existing key
+  double deleteProportion;
+  double scanProportion;
+  Distribution distribution;
+  // Ordered inserts use the key number itself as the key, i.e. monotonically
+  // increasing timestamps that always land at the tail.  Otherwise key
+  // numbers are scattered with a bijective hash.
+  bool orderedInserts;
+  double zipfianConstant;
+  double hotDataFraction;
+  double hotOpnFraction;
+  uint32_t maxScanLength;
+
+  // The YCSB core workloads.  'D' reads the latest inserts, 'E' does short
+  // scans.  'G' is not part of YCSB: append-only timestamps with reads of the
+  // newest entries, the traffic pattern that piles every writer up at the
+  // tail.
+  static WorkloadSpec Preset(char name) {
+    WorkloadSpec spec;
+    switch (name) {
+      case 'A':
+        break;
+      case 'B':
+        spec.readProportion = 0.95;
+        spec.updateProportion = 0.05;
+        break;
+      case 'C':
+        spec.readProportion = 1;
+        spec.updateProportion = 0;
+        break;
+      case 'D':
+        spec.readProportion = 0.95;
+        spec.updateProportion = 0;
+        spec.insertProportion = 0.05;
+        spec.distribution = Distribution::kLatest;
+        break;
+      case 'E':
+        spec.readProportion = 0;
+        spec.updateProportion = 0;
+        spec.scanProportion = 0.95;
+        spec.insertProportion = 0.05;
+        break;
+      case 'F':
+        // read-modify-write is modelled as a read followed by an update
+        spec.readProportion = 0.5;
+        spec.updateProportion = 0.5;
+        break;
+      case 'G':
+        spec.readProportion = 0.5;
+        spec.updateProportion = 0;
+        spec.insertProportion = 0.5;
+        spec.distribution = Distribution::kLatest;
+        spec.orderedInserts = true;
+        break;
+      default:
+        break;
+    }
+    return spec;
+  }
+
+  // Reads overrides such as --read=0.9 --insert=0.1 --distribution=latest.
+  void ApplyFlags(const Flags& flags) {
+    recordCount = flags.GetInt("records", recordCount);
+    readProportion = flags.GetDouble("read", readProportion);
+    insertProportion = flags.GetDouble("insert", insertProportion);
+    updateProportion = flags.GetDouble("update", updateProportion);
+    deleteProportion = flags.GetDouble("delete", deleteProportion);
+    scanProportion = flags.GetDouble("scan", scanProportion);
+    ParseDistribution(flags.GetString("distribution", ""), &distribution);
+    orderedInserts = flags.GetBool("ordered-inserts", orderedInserts);
+    zipfianConstant = flags.GetDouble("zipfian-constant", zipfianConstant);
+    hotDataFraction = flags.GetDouble("hot-data", hotDataFraction);
+    hotOpnFraction = flags.GetDouble("hot-opn", hotOpnFraction);
+    maxScanLength =
+        static_cast<uint32_t>(flags.GetInt("max-scan", maxScanLength));
+  }
+};
+
+// Bijective 64-bit mix (the splitmix64 finalizer), so hashed key numbers
+// never collide.
+inline uint64_t ScatterKey(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+inline BenchKey KeyFor(const WorkloadSpec& spec, uint64_t keynum) {
+  return spec.orderedInserts ? keynum : ScatterKey(keynum);
+}
+
+// Zipfian over [0, items) following Gray et al., "Quickly Generating
+// Billion-Record Synthetic Databases", as done by YCSB.  Item 0 is the most
+// popular.  The zeta constant is expensive to compute, so it is done once
+// for the initial item count and extended analytically when the item count
+// grows (used by the latest distribution).
+class ZipfianGenerator {
+ public:
+  ZipfianGenerator(uint64_t items, double theta)
+      : ZipfianGenerator(items, theta, Zeta(items, theta)) {}
+
+  ZipfianGenerator(uint64_t items, double theta, double zetan)
+      : baseItems_(items),
+        theta_(theta),
+        alpha_(1.0 / (1.0 - theta)),
+        zeta2theta_(Zeta(2, theta)),
+        baseZetan_(zetan) {
+    SetItemCount(items);
+  }
+
+  static double Zeta(uint64_t n, double theta) {
+    double sum = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+      sum += 1 / std::pow(i + 1, theta);
+    }
+    return sum;
+  }
+
+  template <typename Rng>
+  uint64_t Next(Rng& rng, uint64_t items) {
+    // eta costs two pow() calls; a slightly stale item count only makes the
+    // newest few keys unreachable for a moment, so refresh every 0.1%.
+    if (items < items_ || items > items_ + (items_ >> 10)) {
+      SetItemCount(items);
+    }
+    double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, theta_)) {
+      return 1;
+    }
+    uint64_t ret = static_cast<uint64_t>(
+        items_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+    return ret < items_ ? ret : items_ - 1;
+  }
+
+ private:
+  void SetItemCount(uint64_t items) {
+    items_ = items < 2 ? 2 : items;
+    zetan_ = baseZetan_;
+    if (items_ > baseItems_) {
+      // integral approximation of sum_{i = base + 1}^{items} 1 / i^theta
+      zetan_ += (std::pow(static_cast<double>(items_), 1 - theta_) -
+                 std::pow(static_cast<double>(baseItems_), 1 - theta_)) /
+          (1 - theta_);
+    }
+    eta_ = (1 - std::pow(2.0 / items_, 1 - theta_)) /
+        (1 - zeta2theta_ / zetan_);
+  }
+
+  const uint64_t baseItems_;
+  const double theta_;
+  const double alpha_;
+  const double zeta2theta_;
+  const double baseZetan_;
+  uint64_t items_;
+  double zetan_;
+  double eta_;
+};
+
+// State shared by every thread running the same workload.
+class WorkloadState {
+ public:
+  explicit WorkloadState(const WorkloadSpec& spec)
+      : zetan_(spec.distribution == Distribution::kZipfian ||
+                       spec.distribution == Distribution::kLatest
+                   ? ZipfianGenerator::Zeta(spec.recordCount,
+                                            spec.zipfianConstant)
+                   : 0),
+        insertCounter_(spec.recordCount) {}
+
+  double zetan() const { return zetan_; }
+
+  // Key number of the next insert.
+  uint64_t NextInsertKeynum() {
+    return insertCounter_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Number of key numbers handed out so far, including the loaded records.
+  uint64_t KeynumLimit() const {
+    return insertCounter_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  const double zetan_;
+  std::atomic<uint64_t> insertCounter_;
+};
+
+// One generator per thread; it is not thread-safe itself.
+class WorkloadGenerator {
+ public:
+  WorkloadGenerator(const WorkloadSpec& spec, WorkloadState* state,
+                    uint64_t seed)
+      : spec_(spec),
+        state_(state),
+        rng_(seed),
+        zipfian_(spec.recordCount < 2 ? 2 : spec.recordCount,
+                 spec.zipfianConstant, state->zetan()),
+        sequence_(seed % (spec.recordCount ? spec.recordCount : 1)) {
+    double total = spec.readProportion + spec.insertProportion +
+        spec.updateProportion + spec.deleteProportion + spec.scanProportion;
+    if (total <= 0) {
+      total = 1;
+    }
+    double acc = 0;
+    acc += spec.readProportion / total;
+    thresholds_[0] = acc;
+    acc += spec.insertProportion / total;
+    thresholds_[1] = acc;
+    acc += spec.updateProportion / total;
+    thresholds_[2] = acc;
+    acc += spec.deleteProportion / total;
+    thresholds_[3] = acc;
+    thresholds_[4] = 1.0;
+  }
+
+  Operation Next() {
+    Operation op;
+    double p = std::uniform_real_distribution<double>(0, 1)(rng_);
+    int type = 0;
+    while (type < kNumOpTypes - 1 && p >= thresholds_[type]) {
+      ++type;
+    }
+    op.type = static_cast<OpType>(type);
+    op.scanLength = 0;
+    if (op.type == OpType::kInsert) {
+      op.key = KeyFor(spec_, state_->NextInsertKeynum());
+    } else {
+      op.key = KeyFor(spec_, NextKeynum());
+    }
+    if (op.type == OpType::kScan) {
+      op.scanLength = 1 + static_cast<uint32_t>(
+          rng_() % (spec_.maxScanLength ? spec_.maxScanLength : 1));
+    }
+    return op;
+  }
+
+ private:
+  uint64_t NextKeynum() {
+    uint64_t limit = state_->KeynumLimit();
+    if (limit == 0) {
+      return 0;
+    }
+    switch (spec_.distribution) {
+      case Distribution::kUniform:
+        return rng_() % limit;
+      case Distribution::kZipfian:
+        return ScatterKey(zipfian_.Next(rng_, spec_.recordCount)) % limit;
+      case Distribution::kLatest:
+        return limit - 1 - zipfian_.Next(rng_, limit);
+      case Distribution::kSequential:
+        if (sequence_ >= limit) {
+          sequence_ = 0;
+        }
+        return sequence_++;
+      case Distribution::kHotspot: {
+        uint64_t hot = static_cast<uint64_t>(limit * spec_.hotDataFraction);
+        if (hot == 0) {
+          hot = 1;
+        }
+        double p = std::uniform_real_distribution<double>(0, 1)(rng_);
+        if (p < spec_.hotOpnFraction || hot == limit) {
+          return rng_() % hot;
+        }
+        return hot + rng_() % (limit - hot);
+      }
+    }
+    return 0;
+  }
+
+  const WorkloadSpec& spec_;
+  WorkloadState* state_;
+  std::mt19937_64 rng_;
+  ZipfianGenerator zipfian_;
+  uint64_t sequence_;
+  double thresholds_[kNumOpTypes];
+};
+
+struct WorkloadResult {
+  WorkloadResult() : nanos(0) {
+    for (int i = 0; i < kNumOpTypes; ++i) {
+      ops[i] = 0;
+      hits[i] = 0;
+    }
+  }
+
+  uint64_t TotalOps() const {
+    uint64_t total = 0;
+    for (int i = 0; i < kNumOpTypes; ++i) {
+      total += ops[i];
+    }
+    return total;
+  }
+
+  uint64_t ops[kNumOpTypes];
+  uint64_t hits[kNumOpTypes];  // reads that found the key, etc.
+  uint64_t nanos;
+};
+
+template <typename Handle>
+inline bool ApplyOperation(Handle* handle, const Operation& op) {
+  switch (op.type) {
+    case OpType::kRead:
+      return handle->Contains(op.key);
+    case OpType::kInsert:
+      return handle->Insert(op.key);
+    case OpType::kUpdate:
+      // key-only lists: an update replaces the entry
+      return handle->Erase(op.key) && handle->Insert(op.key);
+    case OpType::kDelete:
+      return handle->Erase(op.key);
+    case OpType::kScan: {
+      uint64_t sum = handle->Scan(op.key, op.scanLength);
+      DoNotOptimize(sum);
+      return sum != 0;
+    }
+  }
+  return false;
+}
+
+// Inserts key numbers [0, recordCount) in random order.
+template <typename Adapter>
+void LoadRecords(Adapter* adapter, const WorkloadSpec& spec, uint64_t seed) {
+  std::vector<uint64_t> keynums(spec.recordCount);
+  for (uint64_t i = 0; i < spec.recordCount; ++i) {
+    keynums[i] = i;
+  }
+  std::shuffle(keynums.begin(), keynums.end(), std::mt19937_64(seed));
+  for (uint64_t keynum : keynums) {
+    adapter->Insert(KeyFor(spec, keynum));
+  }
+}
+
+// Runs opsPerThread operations on each of `threads` threads.  Operations are
+// generated on the fly, so generator cost is included in the timing; it is a
+// few ns per op, well below any list operation.
+template <typename Adapter>
+WorkloadResult RunWorkload(Adapter* adapter, const WorkloadSpec& spec,
+                           WorkloadState* state, int threads,
+                           uint64_t opsPerThread, uint64_t seed,
+                           bool pin = false) {
+  std::vector<WorkloadResult> perThread(threads);
+  WorkloadResult total;
+  total.nanos = RunParallel(threads, pin, [&](int t) {
+    ThreadHandle<Adapter> handle(adapter);
+    WorkloadGenerator gen(spec, state, seed + 7919 * (t + 1));
+    WorkloadResult& result = perThread[t];
+    for (uint64_t i = 0; i < opsPerThread; ++i) {
+      Operation op = gen.Next();
+      int type = static_cast<int>(op.type);
+      ++result.ops[type];
+      result.hits[type] += ApplyOperation(&handle, op);
+    }
+  });
+  for (const auto& r : perThread) {
+    for (int i = 0; i < kNumOpTypes; ++i) {
+      total.ops[i] += r.ops[i];
+      total.hits[i] += r.hits[i];
+    }
+  }
+  return total;
+}
+
+}  // namespace bench
+}  // namespace skiplist
+}  // namespace utility
@@ -0,0 +1,195 @@
+// YCSB-style workloads against the thread-safe skiplists.
+//
+// Usage:
+//   ycsb_bench [--workload=A] [--impls=leveldb-tlsf,concurrent]
+//              [--records=1M] [--ops=1M] [--threads=1,2,4]
+//              [--distribution=uniform|zipfian|latest|sequential|hotspot]
+//              [--read=R --insert=I --update=U --delete=D --scan=S]
+//              [--ordered-inserts] [--max-scan=100] [--seed=N] [--perf]
+//              [--record=PREFIX]
+//
+//   --workload  YCSB core workload A-F, or G (append-only timestamps, reads
+//               of the newest keys).  Individual flags override the preset.
+//   --ops       total operations per run, split evenly over the threads.
+//   --perf      hardware counters per operation for every run, summed over
+//               all threads (see perf_counters.h).
+//   --record    write a trace of every run, load included, to
+//               PREFIX-<impl>-t<threads> for trace_replay (see trace.h).
+//               Recording is included in the reported timings.
+//
+// The list is loaded with --records keys before every run.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "adapters.h"
+#include "bench_util.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "workload.h"
+
+using namespace utility::skiplist::bench;
+
+namespace {
+
+const char* DistributionName(Distribution d) {
+  switch (d) {
+    case Distribution::kUniform: return "uniform";
+    case Distribution::kZipfian: return "zipfian";
+    case Distribution::kLatest: return "latest";
+    case Distribution::kSequential: return "sequential";
+    case Distribution::kHotspot: return "hotspot";
+  }
+  return "unknown";
+}
+
+void PrintWorkloadResult(const std::string& impl, int threads,
+                         const WorkloadResult& r) {
+  uint64_t total = r.TotalOps();
+  printf("%-16s %7d %12llu %14.0f %10.1f", impl.c_str(), threads,
+         (unsigned long long)total, total * 1e9 / r.nanos,
+         static_cast<double>(r.nanos) * threads / total);
+  for (int i = 0; i < kNumOpTypes; ++i) {
+    if (r.ops[i] != 0) {
+      printf("  %s=%llu(%.0f%% hit)", OpTypeName(static_cast<OpType>(i)),
+             (unsigned long long)r.ops[i], 100.0 * r.hits[i] / r.ops[i]);
+    }
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+// Hooks around the timed run, only ConcurrentSkipList records latency.
+template <typename Adapter>
+void BeforeRun(Adapter*) {}
+template <typename Adapter>
+void AfterRun(Adapter*) {}
+
+void BeforeRun(ConcurrentSkipListAdapter* adapter) {
+  adapter->list()->resetLatency();
+}
+void AfterRun(ConcurrentSkipListAdapter* adapter) {
+  PrintLatency(*adapter->list());
+}
+
+// --record runs through a TracingAdapter, the hooks belong to the list
+// underneath it.
+template <typename Adapter>
+void BeforeRun(TracingAdapter<Adapter>* adapter) {
+  BeforeRun(adapter->inner());
+}
+template <typename Adapter>
+void AfterRun(TracingAdapter<Adapter>* adapter) {
+  AfterRun(adapter->inner());
+}
+
+template <typename Adapter>
+void Run(const std::string& name, Adapter* adapter, const WorkloadSpec& spec,
+         int threads, uint64_t ops, uint64_t seed, PerfCounters* perf);
+
+template <typename Adapter>
+void Run(const std::string& name, Adapter* adapter, const WorkloadSpec& spec,
+         int threads, uint64_t ops, uint64_t seed, PerfCounters* perf,
+         const std::string& record) {
+  if (record.empty()) {
+    Run(name, adapter, spec, threads, ops, seed, perf);
+    return;
+  }
+  std::string path = record + "-" + name + "-t" + std::to_string(threads);
+  TraceWriter writer(path);
+  if (!writer.ok()) {
+    fprintf(stderr, "cannot write trace %s\n", path.c_str());
+    return;
+  }
+  TracingAdapter<Adapter> traced(adapter, &writer);
+  Run(name, &traced, spec, threads, ops, seed, perf);
+  writer.Close();
+  printf("%16s trace: %s\n", "", path.c_str());
+}
+
+template <typename Adapter>
+void Run(const std::string& name, Adapter* adapter, const WorkloadSpec& spec,
+         int threads, uint64_t ops, uint64_t seed, PerfCounters* perf) {
+  LoadRecords(adapter, spec, seed);
+  BeforeRun(adapter);
+  WorkloadState state(spec);
+  if (perf != nullptr) {
+    perf->Start();
+  }
+  WorkloadResult r = RunWorkload(adapter, spec, &state, threads,
+                                 ops / threads, seed);
+  PerfSample sample;
+  if (perf != nullptr) {
+    sample = perf->Stop();
+  }
+  PrintWorkloadResult(name, threads, r);
+  if (perf != nullptr) {
+    PrintPerf(sample, r.TotalOps());
+  }
+  AfterRun(adapter);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Flags flags(argc, argv);
+  std::string workload = flags.GetString("workload", "A");
+  WorkloadSpec spec = WorkloadSpec::Preset(workload.empty() ? 'A' : workload[0]);
+  spec.ApplyFlags(flags);
+  std::vector<std::string> impls =
+      flags.GetList("impls", "leveldb-tlsf,concurrent");
+  std::vector<std::string> threadCounts = flags.GetList("threads", "1");
+  uint64_t ops = flags.GetInt("ops", 1000000);
+  uint64_t seed = flags.GetInt("seed", 301);
+  std::string record = flags.GetString("record", "");
+  std::unique_ptr<PerfCounters> perfCounters;
+  PerfCounters* perf = nullptr;
+  if (flags.GetBool("perf", false)) {
+    perfCounters.reset(new PerfCounters());
+    if (perfCounters->Available()) {
+      perf = perfCounters.get();
+    } else {
+      printf("perf counters unavailable (%s), --perf ignored\n",
+             perfCounters->Error().c_str());
+    }
+  }
+
+  printf("workload %s: records=%llu read=%.2f insert=%.2f update=%.2f "
+         "delete=%.2f scan=%.2f distribution=%s%s\n",
+         workload.c_str(), (unsigned long long)spec.recordCount,
+         spec.readProportion, spec.insertProportion, spec.updateProportion,
+         spec.deleteProportion, spec.scanProportion,
+         DistributionName(spec.distribution),
+         spec.orderedInserts ? " ordered-inserts" : "");
+  printf("%-16s %7s %12s %14s %10s\n", "impl", "threads", "ops", "ops/s",
+         "ns/op");
+
+  for (const std::string& t : threadCounts) {
+    int threads = static_cast<int>(Flags::ParseCount(t));
+    if (threads <= 0) {
+      continue;
+    }
+    if (ListContains(impls, "leveldb-malloc")) {
+      LevelDBSkipListAdapter adapter(false);
+      Run("leveldb-malloc", &adapter, spec, threads, ops, seed, perf, record);
+    }
+    if (ListContains(impls, "leveldb-tlsf")) {
+      LevelDBSkipListAdapter adapter(true);
+      Run("leveldb-tlsf", &adapter, spec, threads, ops, seed, perf, record);
+    }
+    if (ListContains(impls, "leveldb-arena")) {
+      LevelDBArenaSkipListAdapter adapter;
+      Run("leveldb-arena", &adapter, spec, threads, ops, seed, perf, record);
+    }
+    if (ListContains(impls, "concurrent")) {
+      ConcurrentSkipListAdapter adapter;
+      Run("concurrent", &adapter, spec, threads, ops, seed, perf, record);
+    }
+    if (threads == 1 && ListContains(impls, "std-set")) {
+      StdSetAdapter adapter;
+      Run("std-set", &adapter, spec, threads, ops, seed, perf, record);
+    }
+  }
+  return 0;
+}
@@ -2,14 +2,18 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <limits>
 #include <memory>
 #include <type_traits>
+#include <vector>
 
 #include "concurrent_skiplist_node.h"
 #include "iterators.h"
+#include "latency_histogram.h"
 #include "memory.h"
 #include "microspinlock.h"
+#include "static_tracepoint.h"
 
 namespace utility {
 namespace skiplist {
@@ -33,7 +37,9 @@ template <
     // All nodes are allocated using provided SysAllocator,
     // it should be thread-safe.
     typename NodeAlloc = SysAllocator<char>,
-    int MAX_HEIGHT = 24>
+    int MAX_HEIGHT = 24,
+    // Per-node lock taken by add and remove, see detail::SkipListNode.
+    typename NodeLock = MicroSpinLock>
 class ConcurrentSkipList {
   // MAX_HEIGHT needs to be at least 2 to suppress compiler
   // warnings/errors (Werror=uninitialized triggered due to preds_[1]
@@ -41,11 +47,12 @@ class ConcurrentSkipList {
   static_assert(
       MAX_HEIGHT >= 2 && MAX_HEIGHT < 64,
       "MAX_HEIGHT can only be in the range of [2, 64)");
-  typedef std::unique_lock<MicroSpinLock> ScopedLocker;
-  typedef ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT> SkipListType;
+  typedef std::unique_lock<NodeLock> ScopedLocker;
+  typedef ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT, NodeLock>
+      SkipListType;
 
  public:
-  typedef detail::SkipListNode<T> NodeType;
+  typedef detail::SkipListNode<T, NodeLock> NodeType;
   typedef T value_type;
   typedef T key_type;
 
@@ -103,6 +110,264 @@ class ConcurrentSkipList {
   size_t size() const { return size_.load(std::memory_order_relaxed); }
   bool empty() const { return size() == 0; }
 
+  // Latency of the Accessor operations, merged over all threads.  Always
+  // empty unless built with SKIPLIST_ENABLE_LATENCY_HISTOGRAM.
+  LatencySnapshot latency(LatencyOp op) const {
+#if SKIPLIST_ENABLE_LATENCY_HISTOGRAM
+    return latency_.snapshot(op);
+#else
+    (void)op;
+    return LatencySnapshot();
+#endif
+  }
+
+  void resetLatency() {
+#if SKIPLIST_ENABLE_LATENCY_HISTOGRAM
+    latency_.reset();
+#endif
+  }
+
+  // Snapshot of the contention counters.  The counters are only bumped on
+  // the slow paths (retries, failed validation, head growth), so they are
+  // always on.
+  struct Stats {
+    // extra rounds of the addOrGetData/remove retry loops
+    uint64_t addRetries;
+    uint64_t removeRetries;
+    // lockNodesForChange found a pred marked or relinked after locking it
+    uint64_t lockValidationFailures;
+    uint64_t growHeights;
+    // growHeight lost the head swap to another thread
+    uint64_t growHeightCasFailures;
+    // Process-wide over every MicroSpinLock, not only this list's nodes.
+    uint64_t sleeperWaits;
+    uint64_t sleeperSpins;
+    uint64_t sleeperSleeps;
+  };
+
+  Stats stats() const {
+    Stats s;
+    s.addRetries = counters_.addRetries.load(std::memory_order_relaxed);
+    s.removeRetries = counters_.removeRetries.load(std::memory_order_relaxed);
+    s.lockValidationFailures =
+        counters_.lockValidationFailures.load(std::memory_order_relaxed);
+    s.growHeights = counters_.growHeights.load(std::memory_order_relaxed);
+    s.growHeightCasFailures =
+        counters_.growHeightCasFailures.load(std::memory_order_relaxed);
+    const detail::SleeperStats& sleeper = detail::SleeperStats::instance();
+    s.sleeperWaits = sleeper.waits.load(std::memory_order_relaxed);
+    s.sleeperSpins = sleeper.spins.load(std::memory_order_relaxed);
+    s.sleeperSleeps = sleeper.sleeps.load(std::memory_order_relaxed);
+    return s;
+  }
+
+  // Shape of the list, see structureStats().
+  struct StructureStats {
+    size_t nodes;
+    int height; // head height
+    // levelNodes[i] is the number of nodes linked on layer i, i.e. with
+    // height > i.  idealLevelNodes[i] = nodes / e^i is what
+    // SkipListRandomHeight converges to.
+    std::vector<size_t> levelNodes;
+    std::vector<double> idealLevelNodes;
+    // Half the summed |levelNodes - idealLevelNodes| over the ideal link
+    // count: 0 for a perfectly shaped list.
+    double shapeDistance;
+    // Nodes visited by findNodeDownRight() per search over the sampled
+    // keys, in total and per layer (index 0 = bottom layer).
+    size_t searches;
+    double avgSearchPath;
+    size_t maxSearchPath;
+    std::vector<double> avgLevelVisits;
+    // Comparator invocations per search.
+    double avgComparisons;
+  };
+
+  // Walks the list and replays findNodeDownRight() for every
+  // sampleStride-th key.  O(n + n/sampleStride * log n), meant for
+  // diagnostics.  The caller must hold an Accessor; concurrent writers make
+  // the numbers approximate but are otherwise safe.
+  StructureStats structureStats(size_t sampleStride = 1) const {
+    if (sampleStride == 0) {
+      sampleStride = 1;
+    }
+    StructureStats stats;
+    NodeType* head = head_.load(std::memory_order_acquire);
+    stats.height = head->height();
+    stats.levelNodes.assign(stats.height, 0);
+    std::vector<NodeType*> samples;
+    size_t index = 0;
+    for (NodeType* node = head->next(); node != nullptr;
+         node = node->next(), ++index) {
+      int h = std::min(node->height(), stats.height);
+      for (int i = 0; i < h; ++i) {
+        ++stats.levelNodes[i];
+      }
+      if (index % sampleStride == 0) {
+        samples.push_back(node);
+      }
+    }
+    stats.nodes = index;
+
+    static const double kProbInv = std::exp(1.0);
+    double idealLinks = 0;
+    double misplaced = 0;
+    stats.idealLevelNodes.resize(stats.height);
+    for (int i = 0; i < stats.height; ++i) {
+      stats.idealLevelNodes[i] = stats.nodes / std::pow(kProbInv, i);
+      idealLinks += stats.idealLevelNodes[i];
+      misplaced += std::fabs(stats.levelNodes[i] - stats.idealLevelNodes[i]);
+    }
+    stats.shapeDistance = idealLinks > 0 ? misplaced / (2 * idealLinks) : 0;
+
+    std::vector<size_t> levelVisits(stats.height, 0);
+    size_t totalVisits = 0;
+    size_t totalComparisons = 0;
+    stats.maxSearchPath = 0;
+    for (NodeType* target : samples) {
+      size_t comparisons = 0;
+      size_t path = findNodeDownRightCounted(
+          target->data(), head, &levelVisits, &comparisons);
+      totalVisits += path;
+      totalComparisons += comparisons;
+      stats.maxSearchPath = std::max(stats.maxSearchPath, path);
+    }
+    stats.searches = samples.size();
+    const double searches = samples.empty() ? 1.0 : double(samples.size());
+    stats.avgSearchPath = totalVisits / searches;
+    stats.avgComparisons = totalComparisons / searches;
+    stats.avgLevelVisits.resize(stats.height);
+    for (int i = 0; i < stats.height; ++i) {
+      stats.avgLevelVisits[i] = levelVisits[i] / searches;
+    }
+    return stats;
+  }
+
+  // The two search orders find() can be built on.  find() and every
+  // Accessor operation use kDownRight.
+  enum class Traversal { kDownRight, kRightDown };
+
+  // find() with an explicit traversal order, so that benchmarks can compare
+  // them.  Returns nullptr if data is not in the list or being removed.
+  // The caller must hold an Accessor.
+  const value_type* findWith(Traversal traversal,
+                             const value_type& data) const {
+    std::pair<NodeType*, int> ret = traversal == Traversal::kDownRight
+        ? findNodeDownRight(data)
+        : findNodeRightDown(data);
+    if (ret.second && !ret.first->markedForRemoval()) {
+      return &ret.first->data();
+    }
+    return nullptr;
+  }
+
+  // Estimates the number of elements in [begin, end) without visiting
+  // them: counts the range on the highest layer where it spans at least
+  // minSamples nodes and scales by e per layer, which is the ratio
+  // SkipListRandomHeight keeps between two layers; layer 0 is exact.  The
+  // relative error shrinks like 1/sqrt(minSamples) while the cost grows
+  // like log(n) + e * minSamples.  The caller must hold an Accessor.
+  size_t approximateCount(
+      const value_type& begin,
+      const value_type& end,
+      size_t minSamples = kApproximateSamples) const {
+    static const double kProbInv = std::exp(1.0);
+    NodeType* pred = head_.load(std::memory_order_acquire);
+    int layer = pred->maxLayer();
+    double scale = std::pow(kProbInv, layer);
+    while (true) {
+      NodeType* node = pred->skip(layer);
+      while (this->greater(begin, node)) {
+        pred = node;
+        node = node->skip(layer);
+      }
+      // pred precedes begin on this layer and on every layer below it, the
+      // next layer resumes from there.
+      size_t count = 0;
+      while (this->greater(end, node)) {
+        ++count;
+        node = node->skip(layer);
+      }
+      if (count >= minSamples || layer == 0) {
+        return static_cast<size_t>(count * scale + 0.5);
+      }
+      --layer;
+      scale /= kProbInv;
+    }
+  }
+
+  // Default for approximateCount(), same accuracy as
+  // SkipList::kApproximateSamples in leveldb-skiplist/skiplist.h.
+  static constexpr size_t kApproximateSamples = 16;
+
+  // Memory held by the list, see memoryUsage().  Only the nodes themselves
+  // are counted, not heap memory owned by the values stored in them.
+  struct MemoryUsage {
+    size_t nodes;
+    // heightNodes[h - 1] live nodes of height h, taking heightBytes[h - 1]
+    // bytes as requested from NodeAlloc (SkipListNode::allocSize(h) each).
+    std::vector<size_t> heightNodes;
+    std::vector<size_t> heightBytes;
+    size_t nodeBytes; // sum of heightBytes
+    size_t headBytes;
+    // What NodeAlloc takes on top of the requested bytes of the live nodes
+    // and the head: malloc chunk headers and rounding for SysAllocator,
+    // 0 for allocators AllocatorChunkSize knows nothing about.
+    size_t allocatorOverhead;
+    // Removed nodes (and replaced heads) that the NodeRecycler holds until
+    // the last Accessor goes away, allocator overhead included.
+    size_t recyclerNodes;
+    size_t recyclerBytes;
+    size_t totalBytes;
+  };
+
+  // O(MAX_HEIGHT) from counters maintained by add and remove; concurrent
+  // writers make it approximate.
+  MemoryUsage memoryUsage() const {
+    MemoryUsage usage;
+    usage.nodes = 0;
+    usage.nodeBytes = 0;
+    usage.allocatorOverhead = 0;
+    usage.heightNodes.resize(MAX_HEIGHT);
+    usage.heightBytes.resize(MAX_HEIGHT);
+    for (int h = 1; h <= MAX_HEIGHT; ++h) {
+      size_t count = heightNodes_[h - 1].load(std::memory_order_relaxed);
+      size_t bytes = NodeType::allocSize(h);
+      usage.heightNodes[h - 1] = count;
+      usage.heightBytes[h - 1] = count * bytes;
+      usage.nodes += count;
+      usage.nodeBytes += count * bytes;
+      usage.allocatorOverhead += count * (chunkSize(bytes) - bytes);
+    }
+    usage.headBytes = NodeType::allocSize(height());
+    usage.allocatorOverhead += chunkSize(usage.headBytes) - usage.headBytes;
+    usage.recyclerNodes = recycler_.pendingNodes();
+    usage.recyclerBytes = recycler_.pendingBytes();
+    usage.totalBytes = usage.nodeBytes + usage.headBytes +
+        usage.allocatorOverhead + usage.recyclerBytes;
+    return usage;
+  }
+
+  // memoryUsage().totalBytes without building the per-height breakdown.
+  size_t approximateMemoryUsage() const {
+    size_t total = chunkSize(NodeType::allocSize(height()));
+    for (int h = 1; h <= MAX_HEIGHT; ++h) {
+      total += heightNodes_[h - 1].load(std::memory_order_relaxed) *
+          chunkSize(NodeType::allocSize(h));
+    }
+    return total + recycler_.pendingBytes();
+  }
+
+  // Also clears the process-wide sleeper counters.
+  void resetStats() {
+    counters_.addRetries.store(0, std::memory_order_relaxed);
+    counters_.removeRetries.store(0, std::memory_order_relaxed);
+    counters_.lockValidationFailures.store(0, std::memory_order_relaxed);
+    counters_.growHeights.store(0, std::memory_order_relaxed);
+    counters_.growHeightCasFailures.store(0, std::memory_order_relaxed);
+    detail::SleeperStats::instance().reset();
+  }
+
   //===================================================================
   // Below are implementation details.
   // Please see ConcurrentSkipList::Accessor for stdlib-like APIs.
@@ -166,6 +431,14 @@ class ConcurrentSkipList {
     return size_.fetch_add(delta, std::memory_order_relaxed) + delta;
   }
 
+  static void bumpCounter(std::atomic<uint64_t>& counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static size_t chunkSize(size_t bytes) {
+    return AllocatorChunkSize<NodeAlloc>::of(bytes);
+  }
+
   // Returns the node if found, nullptr otherwise.
   NodeType* find(const value_type& data) {
     auto ret = findNode(data);
@@ -203,6 +476,9 @@ class ConcurrentSkipList {
       }
     }
 
+    if (!valid) {
+      bumpCounter(counters_.lockValidationFailures);
+    }
     return valid;
   }
 
@@ -217,7 +493,10 @@ class ConcurrentSkipList {
     NodeType *preds[MAX_HEIGHT], *succs[MAX_HEIGHT];
     NodeType* newNode;
     size_t newSize;
-    while (true) {
+    for (bool retry = false;; retry = true) {
+      if (retry) {
+        bumpCounter(counters_.addRetries);
+      }
       int max_layer = 0;
       int layer = findInsertionPointGetMaxLayer(data, preds, succs, &max_layer);
 
@@ -252,6 +531,8 @@ class ConcurrentSkipList {
 
       newNode->setFullyLinked();
       newSize = incrementSize(1);
+      heightNodes_[nodeHeight - 1].fetch_add(1, std::memory_order_relaxed);
+      SKIPLIST_TRACEPOINT(concurrent_add, this, nodeHeight, newSize);
       break;
     }
 
@@ -273,7 +554,10 @@ class ConcurrentSkipList {
     int nodeHeight = 0;
     NodeType *preds[MAX_HEIGHT], *succs[MAX_HEIGHT];
 
-    while (true) {
+    for (bool retry = false;; retry = true) {
+      if (retry) {
+        bumpCounter(counters_.removeRetries);
+      }
       int max_layer = 0;
       int layer = findInsertionPointGetMaxLayer(data, preds, succs, &max_layer);
       if (!isMarked && (layer < 0 || !okToDelete(succs[layer], layer))) {
@@ -302,6 +586,8 @@ class ConcurrentSkipList {
       }
 
       incrementSize(-1);
+      heightNodes_[nodeHeight - 1].fetch_sub(1, std::memory_order_relaxed);
+      SKIPLIST_TRACEPOINT(concurrent_remove, this, nodeHeight, size());
       break;
     }
     recycle(nodeToDelete);
@@ -383,6 +669,61 @@ class ConcurrentSkipList {
     return std::make_pair(node, found);
   }
 
+  // findNodeDownRight() from a fixed head, counting the nodes loaded per
+  // layer and the comparator calls.  Returns the number of nodes loaded.
+  size_t findNodeDownRightCounted(
+      const value_type& data,
+      NodeType* head,
+      std::vector<size_t>* levelVisits,
+      size_t* comparisons) const {
+    NodeType* pred = head;
+    int ht = std::min<int>(pred->height(), levelVisits->size());
+    NodeType* node = nullptr;
+    size_t path = 0;
+    auto visit = [&](int layer) {
+      ++(*levelVisits)[layer];
+      ++path;
+    };
+
+    bool found = false;
+    while (!found) {
+      // stepping down
+      for (; ht > 0; --ht) {
+        node = pred->skip(ht - 1);
+        visit(ht - 1);
+        if (node != nullptr) {
+          ++*comparisons;
+        }
+        if (!this->less(data, node)) {
+          break;
+        }
+      }
+      if (ht == 0) {
+        return path;
+      }
+      --ht;
+
+      // stepping right
+      while (true) {
+        bool greater = this->greater(data, node);
+        if (node != nullptr) {
+          ++*comparisons;
+        }
+        if (!greater) {
+          break;
+        }
+        pred = node;
+        node = node->skip(ht);
+        visit(ht);
+      }
+      found = !this->less(data, node);
+      if (node != nullptr) {
+        ++*comparisons;
+      }
+    }
+    return path;
+  }
+
   // find node by first stepping right then stepping down.
   // We still keep this for reference purposes.
   std::pair<NodeType*, int> findNodeRightDown(const value_type& data) const {
@@ -427,10 +768,13 @@ class ConcurrentSkipList {
               expected, newHead, std::memory_order_release)) {
         // if someone has already done the swap, just return.
         NodeType::destroy(recycler_.alloc(), newHead);
+        bumpCounter(counters_.growHeightCasFailures);
         return;
       }
       oldHead->setMarkedForRemoval();
     }
+    bumpCounter(counters_.growHeights);
+    SKIPLIST_TRACEPOINT(concurrent_grow_height, this, oldHead->height(), height);
     recycle(oldHead);
   }
 
@@ -439,14 +783,35 @@ class ConcurrentSkipList {
   detail::NodeRecycler<NodeType, NodeAlloc> recycler_;
   std::atomic<NodeType*> head_;
   std::atomic<size_t> size_{0};
+  // heightNodes_[h - 1] is the number of linked nodes of height h.
+  std::atomic<size_t> heightNodes_[MAX_HEIGHT] = {};
 
   Comparator const cmp_;
+
+  struct Counters {
+    std::atomic<uint64_t> addRetries{0};
+    std::atomic<uint64_t> removeRetries{0};
+    std::atomic<uint64_t> lockValidationFailures{0};
+    std::atomic<uint64_t> growHeights{0};
+    std::atomic<uint64_t> growHeightCasFailures{0};
+  };
+  Counters counters_;
+
+#if SKIPLIST_ENABLE_LATENCY_HISTOGRAM
+  detail::LatencyRecorder latency_;
+#endif
 };
 
-template <typename T, typename Comparator, typename NodeAlloc, int MAX_HEIGHT>
-class ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT>::Accessor {
-  typedef detail::SkipListNode<T> NodeType;
-  typedef ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT> SkipListType;
+template <
+    typename T,
+    typename Comparator,
+    typename NodeAlloc,
+    int MAX_HEIGHT,
+    typename NodeLock>
+class ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT, NodeLock>::Accessor {
+  typedef detail::SkipListNode<T, NodeLock> NodeType;
+  typedef ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT, NodeLock>
+      SkipListType;
 
  public:
   typedef T value_type;
@@ -485,14 +850,14 @@ class ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT>::Accessor {
   Accessor& operator=(const Accessor& accessor) {
     if (this != &accessor) {
       slHolder_ = accessor.slHolder_;
-      sl_->recycler_.releaseRef();
+      release();
       sl_ = accessor.sl_;
       sl_->recycler_.addRef();
     }
     return *this;
   }
 
-  ~Accessor() { sl_->recycler_.releaseRef(); }
+  ~Accessor() { release(); }
 
   bool empty() const { return sl_->size() == 0; }
   size_t size() const { return sl_->size(); }
@@ -501,8 +866,12 @@ class ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT>::Accessor {
   // returns end() if the value is not in the list, otherwise returns an
   // iterator pointing to the data, and it's guaranteed that the data is valid
   // as far as the Accessor is hold.
-  iterator find(const key_type& value) { return iterator(sl_->find(value)); }
+  iterator find(const key_type& value) {
+    SKIPLIST_LATENCY_SCOPE(sl_->latency_, LatencyOp::kFind);
+    return iterator(sl_->find(value));
+  }
   const_iterator find(const key_type& value) const {
+    SKIPLIST_LATENCY_SCOPE(sl_->latency_, LatencyOp::kFind);
     return iterator(sl_->find(value));
   }
   size_type count(const key_type& data) const { return contains(data); }
@@ -520,12 +889,14 @@ class ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT>::Accessor {
       typename =
           typename std::enable_if<std::is_convertible<U, T>::value>::type>
   std::pair<iterator, bool> insert(U&& data) {
+    SKIPLIST_LATENCY_SCOPE(sl_->latency_, LatencyOp::kInsert);
     auto ret = sl_->addOrGetData(std::forward<U>(data));
     return std::make_pair(iterator(ret.first), ret.second);
   }
   size_t erase(const key_type& data) { return remove(data); }
 
   iterator lower_bound(const key_type& data) const {
+    SKIPLIST_LATENCY_SCOPE(sl_->latency_, LatencyOp::kLowerBound);
     return iterator(sl_->lower_bound(data));
   }
 
@@ -551,26 +922,64 @@ class ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT>::Accessor {
   // or a race condition happened (i.e. the used-to-be last element
   // was already removed by another thread).
   bool pop_back() {
+    SKIPLIST_LATENCY_SCOPE(sl_->latency_, LatencyOp::kPopBack);
     auto last = sl_->last();
     return last ? sl_->remove(*last) : false;
   }
 
   std::pair<key_type*, bool> addOrGetData(const key_type& data) {
+    SKIPLIST_LATENCY_SCOPE(sl_->latency_, LatencyOp::kInsert);
     auto ret = sl_->addOrGetData(data);
     return std::make_pair(&ret.first->data(), ret.second);
   }
 
   SkipListType* skiplist() const { return sl_; }
 
+  typename SkipListType::StructureStats structureStats(
+      size_t sampleStride = 1) const {
+    return sl_->structureStats(sampleStride);
+  }
+
+  typename SkipListType::MemoryUsage memoryUsage() const {
+    return sl_->memoryUsage();
+  }
+
+  size_t approximateMemoryUsage() const {
+    return sl_->approximateMemoryUsage();
+  }
+
+  size_t approximateCount(
+      const key_type& begin,
+      const key_type& end,
+      size_t minSamples = SkipListType::kApproximateSamples) const {
+    return sl_->approximateCount(begin, end, minSamples);
+  }
+
   // legacy interfaces
   // TODO:(xliu) remove these.
   // Returns true if the node is added successfully, false if not, i.e. the
   // node with the same key already existed in the list.
-  bool contains(const key_type& data) const { return sl_->find(data); }
-  bool add(const key_type& data) { return sl_->addOrGetData(data).second; }
-  bool remove(const key_type& data) { return sl_->remove(data); }
+  bool contains(const key_type& data) const {
+    SKIPLIST_LATENCY_SCOPE(sl_->latency_, LatencyOp::kFind);
+    return sl_->find(data);
+  }
+  bool add(const key_type& data) {
+    SKIPLIST_LATENCY_SCOPE(sl_->latency_, LatencyOp::kInsert);
+    return sl_->addOrGetData(data).second;
+  }
+  bool remove(const key_type& data) {
+    SKIPLIST_LATENCY_SCOPE(sl_->latency_, LatencyOp::kErase);
+    return sl_->remove(data);
+  }
 
  private:
+  // The last Accessor out frees every node the recycler held back, which can
+  // be a long stall; timed so that it shows up next to the other ops.
+  void release() {
+    SKIPLIST_LATENCY_SCOPE(sl_->latency_, LatencyOp::kRelease);
+    sl_->recycler_.releaseRef();
+  }
+
   SkipListType* sl_;
   std::shared_ptr<SkipListType> slHolder_;
 };
@@ -617,10 +1026,16 @@ class detail::csl_iterator : public detail::IteratorFacade<
 };
 
 // Skipper interface
-template <typename T, typename Comparator, typename NodeAlloc, int MAX_HEIGHT>
-class ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT>::Skipper {
-  typedef detail::SkipListNode<T> NodeType;
-  typedef ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT> SkipListType;
+template <
+    typename T,
+    typename Comparator,
+    typename NodeAlloc,
+    int MAX_HEIGHT,
+    typename NodeLock>
+class ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT, NodeLock>::Skipper {
+  typedef detail::SkipListNode<T, NodeLock> NodeType;
+  typedef ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT, NodeLock>
+      SkipListType;
   typedef typename SkipListType::Accessor Accessor;
 
  public:
@@ -706,12 +1121,13 @@ class ConcurrentSkipList<T, Comparator, NodeAlloc, MAX_HEIGHT>::Skipper {
 
     int lyr = hints_[layer];
     int max_layer = maxLayer();
-    while (this->greater(data, succs_[lyr]) && lyr < max_layer) {
+    const SkipListType* sl = accessor_.skiplist();
+    while (sl->greater(data, succs_[lyr]) && lyr < max_layer) {
       ++lyr;
     }
     hints_[layer] = lyr; // update the hint
 
-    int foundLayer = this->findInsertionPoint(
+    int foundLayer = sl->findInsertionPoint(
         preds_[lyr], lyr, data, preds_, succs_);
     if (foundLayer < 0) {
       return false;
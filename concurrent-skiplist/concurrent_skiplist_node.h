@@ -15,6 +15,7 @@
 #include "constexpr_math.h"
 #include "memory.h"
 #include "microspinlock.h"
+#include "static_tracepoint.h"
 
 
 template <typename T, typename... Args>
@@ -29,7 +30,10 @@ namespace detail {
 template <typename ValT, typename NodeT>
 class csl_iterator;
 
-template <typename T>
+// NodeLock guards a node's links while it is changed.  It needs lock() and
+// unlock() and must be default constructible; a value-initialized
+// MicroSpinLock is an unlocked one.
+template <typename T, typename NodeLock = MicroSpinLock>
 class SkipListNode {
   enum : uint16_t {
     IS_HEAD_NODE = 1,
@@ -52,8 +56,7 @@ class SkipListNode {
       NodeAlloc& alloc, int height, U&& data, bool isHead = false) {
     // DCHECK(height >= 1 && height < 64) << height;
 
-    size_t size =
-        sizeof(SkipListNode) + height * sizeof(std::atomic<SkipListNode*>);
+    size_t size = allocSize(height);
     auto storage = std::allocator_traits<NodeAlloc>::allocate(alloc, size);
     // do placement new
     return new (storage)
@@ -62,13 +65,17 @@ class SkipListNode {
 
   template <typename NodeAlloc>
   static void destroy(NodeAlloc& alloc, SkipListNode* node) {
-    size_t size = sizeof(SkipListNode) +
-        node->height_ * sizeof(std::atomic<SkipListNode*>);
+    size_t size = allocSize(node->height_);
     node->~SkipListNode();
     std::allocator_traits<NodeAlloc>::deallocate(
         alloc, typename std::allocator_traits<NodeAlloc>::pointer(node), size);
   }
 
+  // Bytes create() requests from the allocator for a node of this height.
+  static size_t allocSize(int height) {
+    return sizeof(SkipListNode) + height * sizeof(std::atomic<SkipListNode*>);
+  }
+
   template <typename NodeAlloc>
   struct DestroyIsNoOp : StrictConjunction<
                              AllocatorHasTrivialDeallocate<NodeAlloc>,
@@ -108,8 +115,8 @@ class SkipListNode {
   int maxLayer() const { return height_ - 1; }
   int height() const { return height_; }
 
-  std::unique_lock<MicroSpinLock> acquireGuard() {
-    return std::unique_lock<MicroSpinLock>(spinLock_);
+  std::unique_lock<NodeLock> acquireGuard() {
+    return std::unique_lock<NodeLock>(spinLock_);
   }
 
   bool fullyLinked() const { return getFlags() & FULLY_LINKED; }
@@ -126,8 +133,7 @@ class SkipListNode {
   // Note! this can only be called from create() as a placement new.
   template <typename U>
   SkipListNode(uint8_t height, U&& data, bool isHead)
-      : height_(height), data_(std::forward<U>(data)) {
-    spinLock_.init();
+      : height_(height), spinLock_(), data_(std::forward<U>(data)) {
     setFlags(0);
     if (isHead) {
       setIsHeadNode();
@@ -155,7 +161,7 @@ class SkipListNode {
   // MicroSpinLock.
   std::atomic<uint16_t> flags_;
   const uint8_t height_;
-  MicroSpinLock spinLock_;
+  NodeLock spinLock_;
 
   value_type data_;
 
@@ -239,11 +245,15 @@ class NodeRecycler<
         !NodeType::template DestroyIsNoOp<NodeAlloc>::value>::type> {
  public:
   explicit NodeRecycler(const NodeAlloc& alloc)
-      : refs_(0), dirty_(false), alloc_(alloc) {
+      : refs_(0), dirty_(false), pendingNodes_(0), pendingBytes_(0),
+        alloc_(alloc) {
     lock_.init();
   }
 
-  explicit NodeRecycler() : refs_(0), dirty_(false) { lock_.init(); }
+  explicit NodeRecycler()
+      : refs_(0), dirty_(false), pendingNodes_(0), pendingBytes_(0) {
+    lock_.init();
+  }
 
   ~NodeRecycler() {
     // CHECK_EQ(refs(), 0);
@@ -257,12 +267,16 @@ class NodeRecycler<
   void add(NodeType* node) {
     std::lock_guard<MicroSpinLock> g(lock_);
     if (nodes_.get() == nullptr) {
-      nodes_ = make_unique<std::vector<NodeType*>>(1, node);
+      nodes_ = ::make_unique<std::vector<NodeType*>>(1, node);
     } else {
       nodes_->push_back(node);
     }
     // DCHECK_GT(refs(), 0);
     dirty_.store(true, std::memory_order_relaxed);
+    pendingNodes_.fetch_add(1, std::memory_order_relaxed);
+    pendingBytes_.fetch_add(
+        AllocatorChunkSize<NodeAlloc>::of(NodeType::allocSize(node->height())),
+        std::memory_order_relaxed);
   }
 
   int addRef() { return refs_.fetch_add(1, std::memory_order_acq_rel); }
@@ -290,26 +304,41 @@ class NodeRecycler<
         // added after this.
         newNodes.swap(nodes_);
         dirty_.store(false, std::memory_order_relaxed);
+        pendingNodes_.store(0, std::memory_order_relaxed);
+        pendingBytes_.store(0, std::memory_order_relaxed);
       }
     }
     // TODO(xliu) should we spawn a thread to do this when there are large
     // number of nodes in the recycler?
     if (newNodes) {
+      SKIPLIST_TRACEPOINT(recycler_release, this, newNodes->size());
       for (auto& node : *newNodes) {
         NodeType::destroy(alloc_, node);
       }
+      SKIPLIST_TRACEPOINT(recycler_release_done, this, newNodes->size());
     }
     return ret;
   }
 
   NodeAlloc& alloc() { return alloc_; }
 
+  // Removed nodes waiting for the last Accessor to go away, and the bytes
+  // they hold including allocator overhead.
+  size_t pendingNodes() const {
+    return pendingNodes_.load(std::memory_order_relaxed);
+  }
+  size_t pendingBytes() const {
+    return pendingBytes_.load(std::memory_order_relaxed);
+  }
+
  private:
   int refs() const { return refs_.load(std::memory_order_relaxed); }
 
   std::unique_ptr<std::vector<NodeType*>> nodes_;
   std::atomic<int32_t> refs_; // current number of visitors to the list
   std::atomic<bool> dirty_; // whether *nodes_ is non-empty
+  std::atomic<size_t> pendingNodes_; // nodes_->size()
+  std::atomic<size_t> pendingBytes_;
   MicroSpinLock lock_; // protects access to *nodes_
   NodeAlloc alloc_;
 };
@@ -332,6 +361,9 @@ class NodeRecycler<
 
   NodeAlloc& alloc() { return alloc_; }
 
+  size_t pendingNodes() const { return 0; }
+  size_t pendingBytes() const { return 0; }
+
  private:
   NodeAlloc alloc_;
 };
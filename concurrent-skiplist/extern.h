@@ -70,4 +70,4 @@
     }                                               \
   };                                                \
   template <bool E, typename N = decltype(name)>    \
-  inline N* varname = __folly_extern_accessor_##varname::get<E, N>()
\ No newline at end of file
+  inline N* varname = __folly_extern_accessor_##varname::get<E, N>()
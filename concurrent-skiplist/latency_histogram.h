@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Per-operation latency recording on ConcurrentSkipList::Accessor.
+//
+// Define SKIPLIST_ENABLE_LATENCY_HISTOGRAM to 1 before including
+// concurrent_skiplist.h to record the latency of insert/add, find/contains,
+// erase/remove, lower_bound and pop_back, and of releasing an Accessor
+// (kRelease), where the last Accessor out destroys the nodes the
+// NodeRecycler held back.  Every thread records into its own
+// histograms; ConcurrentSkipList::latency() merges them into a snapshot.
+// When the macro is 0 (the default) nothing is recorded and the list carries
+// no recorder; latency() then always returns an empty snapshot.
+#ifndef SKIPLIST_ENABLE_LATENCY_HISTOGRAM
+#define SKIPLIST_ENABLE_LATENCY_HISTOGRAM 0
+#endif
+
+namespace utility {
+namespace skiplist {
+
+enum class LatencyOp : int {
+  kInsert = 0,
+  kFind,
+  kErase,
+  kLowerBound,
+  kPopBack,
+  kRelease,
+};
+
+constexpr int kNumLatencyOps = 6;
+
+// All values in nanoseconds.  Percentiles are the upper edge of the bucket
+// the rank falls into, so they over-report by at most 1/32 (~3%).
+struct LatencySnapshot {
+  uint64_t count = 0;
+  uint64_t min = 0;
+  uint64_t max = 0;
+  double mean = 0;
+  uint64_t p50 = 0;
+  uint64_t p90 = 0;
+  uint64_t p99 = 0;
+  uint64_t p999 = 0;
+};
+
+namespace detail {
+
+// HDR-style log-linear histogram over uint64 values: every power of two is
+// split into 32 linear sub-buckets.  Written by a single thread, read by any;
+// the counters are atomics only so that concurrent snapshots are race-free,
+// recording is a plain load + store.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 5;
+  static constexpr int kSubBucketCount = 1 << kSubBucketBits;
+  static constexpr int kBucketCount = (64 - kSubBucketBits + 1) * kSubBucketCount;
+
+  LatencyHistogram() { reset(); }
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void record(uint64_t value) {
+    bump(counts_[bucketIndex(value)], 1);
+    bump(total_, 1);
+    bump(sum_, value);
+    if (value > max_.load(std::memory_order_relaxed)) {
+      max_.store(value, std::memory_order_relaxed);
+    }
+    if (value < min_.load(std::memory_order_relaxed)) {
+      min_.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  void reset() {
+    for (auto& c : counts_) {
+      c.store(0, std::memory_order_relaxed);
+    }
+    total_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+    min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+  }
+
+  // Adds other's counts into this histogram.
+  void merge(const LatencyHistogram& other) {
+    for (int i = 0; i < kBucketCount; ++i) {
+      bump(counts_[i], other.counts_[i].load(std::memory_order_relaxed));
+    }
+    bump(total_, other.total_.load(std::memory_order_relaxed));
+    bump(sum_, other.sum_.load(std::memory_order_relaxed));
+    max_.store(std::max(max_.load(std::memory_order_relaxed),
+                        other.max_.load(std::memory_order_relaxed)),
+               std::memory_order_relaxed);
+    min_.store(std::min(min_.load(std::memory_order_relaxed),
+                        other.min_.load(std::memory_order_relaxed)),
+               std::memory_order_relaxed);
+  }
+
+  uint64_t count() const { return total_.load(std::memory_order_relaxed); }
+
+  // q in [0, 1].
+  uint64_t percentile(double q) const {
+    uint64_t total = count();
+    if (total == 0) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * total + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, total));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+      seen += counts_[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return std::min(bucketUpperEdge(i),
+                        max_.load(std::memory_order_relaxed));
+      }
+    }
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  LatencySnapshot snapshot() const {
+    LatencySnapshot s;
+    s.count = count();
+    if (s.count == 0) {
+      return s;
+    }
+    s.min = min_.load(std::memory_order_relaxed);
+    s.max = max_.load(std::memory_order_relaxed);
+    s.mean = static_cast<double>(sum_.load(std::memory_order_relaxed)) /
+        s.count;
+    s.p50 = percentile(0.5);
+    s.p90 = percentile(0.9);
+    s.p99 = percentile(0.99);
+    s.p999 = percentile(0.999);
+    return s;
+  }
+
+  static int bucketIndex(uint64_t value) {
+    if (value < static_cast<uint64_t>(kSubBucketCount)) {
+      return static_cast<int>(value);
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - kSubBucketBits;
+    int top = static_cast<int>(value >> shift);  // in [32, 64)
+    return (shift + 1) * kSubBucketCount + (top - kSubBucketCount);
+  }
+
+  static uint64_t bucketUpperEdge(int index) {
+    if (index < kSubBucketCount) {
+      return static_cast<uint64_t>(index);
+    }
+    int shift = index / kSubBucketCount - 1;
+    uint64_t top = static_cast<uint64_t>(index % kSubBucketCount) +
+        kSubBucketCount;
+    return ((top + 1) << shift) - 1;
+  }
+
+ private:
+  static void bump(std::atomic<uint64_t>& c, uint64_t delta) {
+    c.store(c.load(std::memory_order_relaxed) + delta,
+            std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> counts_[kBucketCount];
+  std::atomic<uint64_t> total_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+  std::atomic<uint64_t> min_;
+};
+
+// Owns one set of histograms per recording thread.  A thread finds its own
+// set through a one-entry thread-local cache keyed by the recorder id, so
+// the registry lock is only taken the first time a thread records, or when
+// it switches between lists.
+class LatencyRecorder {
+ public:
+  LatencyRecorder() : id_(nextId()) {}
+
+  LatencyRecorder(const LatencyRecorder&) = delete;
+  LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+  void record(LatencyOp op, uint64_t nanos) {
+    localSlot()->hist[static_cast<int>(op)].record(nanos);
+  }
+
+  LatencySnapshot snapshot(LatencyOp op) const {
+    LatencyHistogram merged;
+    std::lock_guard<std::mutex> g(mutex_);
+    for (const auto& entry : slots_) {
+      merged.merge(entry.second->hist[static_cast<int>(op)]);
+    }
+    return merged.snapshot();
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> g(mutex_);
+    for (auto& entry : slots_) {
+      for (auto& h : entry.second->hist) {
+        h.reset();
+      }
+    }
+  }
+
+ private:
+  struct Slot {
+    LatencyHistogram hist[kNumLatencyOps];
+  };
+
+  struct Cache {
+    uint64_t id;
+    Slot* slot;
+  };
+
+  static uint64_t nextId() {
+    static std::atomic<uint64_t> next(1);
+    return next.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Slot* localSlot() {
+    static thread_local Cache cache = {0, nullptr};
+    if (cache.id == id_) {
+      return cache.slot;
+    }
+    std::lock_guard<std::mutex> g(mutex_);
+    std::unique_ptr<Slot>& slot = slots_[std::this_thread::get_id()];
+    if (!slot) {
+      slot.reset(new Slot());
+    }
+    cache.id = id_;
+    cache.slot = slot.get();
+    return cache.slot;
+  }
+
+  const uint64_t id_;
+  mutable std::mutex mutex_;
+  std::map<std::thread::id, std::unique_ptr<Slot>> slots_;
+};
+
+class LatencyScope {
+ public:
+  LatencyScope(LatencyRecorder& recorder, LatencyOp op)
+      : recorder_(recorder), op_(op), start_(std::chrono::steady_clock::now()) {}
+
+  ~LatencyScope() {
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    recorder_.record(
+        op_,
+        static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                .count()));
+  }
+
+ private:
+  LatencyRecorder& recorder_;
+  LatencyOp op_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace detail
+} // namespace skiplist
+} // namespace utility
+
+#if SKIPLIST_ENABLE_LATENCY_HISTOGRAM
+#define SKIPLIST_LATENCY_SCOPE(recorder, op) \
+  ::utility::skiplist::detail::LatencyScope skiplist_latency_scope_(recorder, op)
+#else
+#define SKIPLIST_LATENCY_SCOPE(recorder, op) static_cast<void>(0)
+#endif
@@ -137,6 +137,32 @@ struct AllocatorHasTrivialDeallocate<CxxAllocatorAdaptor<T, Alloc>>
     : AllocatorHasTrivialDeallocate<Alloc> {};
 
 
+/**
+ * AllocatorChunkSize
+ *
+ * Estimates how many bytes Alloc really takes for an allocate() of `size`
+ * bytes, i.e. the request plus headers and rounding.  Defaults to `size`
+ * for allocators we know nothing about.
+ */
+template <typename Alloc>
+struct AllocatorChunkSize {
+  static size_t of(size_t size) { return size; }
+};
+
+// SysAllocator is malloc: on 64-bit glibc a chunk is the request plus an
+// 8-byte size header, rounded up to 16 bytes, and at least 32 bytes.
+template <typename T>
+struct AllocatorChunkSize<SysAllocator<T>> {
+  static size_t of(size_t size) {
+    const size_t kHeader = sizeof(size_t);
+    const size_t kAlign = 2 * sizeof(size_t);
+    const size_t kMinChunk = 4 * sizeof(size_t);
+    size_t chunk = (size + kHeader + kAlign - 1) & ~(kAlign - 1);
+    return chunk < kMinChunk ? kMinChunk : chunk;
+  }
+};
+
+
 
 
 
@@ -50,6 +50,7 @@ struct MicroSpinLock {
         sleeper.wait();
       } while (payload()->load(std::memory_order_relaxed) == LOCKED);
     }
+    sleeper.publishStats();
     assert(payload()->load() == LOCKED);
     annotate_rwlock_acquired(
         this, annotate_rwlock_level::wrlock, __FILE__, __LINE__);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <thread>
@@ -15,10 +16,10 @@ namespace detail {
 inline void asm_volatile_pause() {
 #if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
   ::_mm_pause();
-#elif defined(__i386__) || FOLLY_X64 || \
+#elif defined(__i386__) || defined(__x86_64__) || \
     (defined(__mips_isa_rev) && __mips_isa_rev > 1)
   asm volatile("pause");
-#elif FOLLY_AARCH64
+#elif defined(__aarch64__)
   asm volatile("isb");
 #elif (defined(__arm__) && !(__ARM_ARCH < 7))
   asm volatile("yield");
@@ -27,6 +28,27 @@ inline void asm_volatile_pause() {
 #endif
 }
 
+/*
+ * Process-wide totals over every Sleeper that had to wait, published by
+ * Sleeper::publishStats().  Uncontended lock acquisitions never touch them.
+ */
+struct SleeperStats {
+  std::atomic<uint64_t> waits{0}; // contended acquisitions
+  std::atomic<uint64_t> spins{0}; // pause instructions issued
+  std::atomic<uint64_t> sleeps{0}; // sleep_for(delta) calls
+
+  static SleeperStats& instance() {
+    static SleeperStats stats;
+    return stats;
+  }
+
+  void reset() {
+    waits.store(0, std::memory_order_relaxed);
+    spins.store(0, std::memory_order_relaxed);
+    sleeps.store(0, std::memory_order_relaxed);
+  }
+};
+
 /*
  * A helper object for the contended case. Starts off with eager
  * spinning, and falls back to sleeping for small quantums.
@@ -37,15 +59,17 @@ static constexpr std::chrono::nanoseconds kMinYieldingSleep =
 class Sleeper {
   const std::chrono::nanoseconds delta;
   uint32_t spinCount;
+  uint32_t sleepCount;
 
   static constexpr uint32_t kMaxActiveSpin = 4000;
 
  public:
 
-  constexpr Sleeper() noexcept : delta(kMinYieldingSleep), spinCount(0) {}
+  constexpr Sleeper() noexcept
+      : delta(kMinYieldingSleep), spinCount(0), sleepCount(0) {}
 
   explicit Sleeper(std::chrono::nanoseconds d) noexcept
-      : delta(d), spinCount(0) {}
+      : delta(d), spinCount(0), sleepCount(0) {}
 
   void wait() noexcept {
     if (spinCount < kMaxActiveSpin) {
@@ -53,9 +77,24 @@ class Sleeper {
       asm_volatile_pause();
     } else {
       /* sleep override */
+      ++sleepCount;
       std::this_thread::sleep_for(delta);
     }
   }
+
+  // Adds this sleeper's spins and sleeps to SleeperStats.  A no-op if
+  // wait() was never called.
+  void publishStats() noexcept {
+    if (spinCount == 0) {
+      return;
+    }
+    SleeperStats& stats = SleeperStats::instance();
+    stats.waits.fetch_add(1, std::memory_order_relaxed);
+    stats.spins.fetch_add(spinCount, std::memory_order_relaxed);
+    if (sleepCount != 0) {
+      stats.sleeps.fetch_add(sleepCount, std::memory_order_relaxed);
+    }
+  }
 };
 
 } // namespace detail
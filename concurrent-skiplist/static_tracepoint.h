@@ -0,0 +1,97 @@
+#pragma once
+
+#include <type_traits>
+
+/**
+ * @brief 编译期静态探针（USDT），供bpftrace/perf/SystemTap在线挂载
+ *
+ * 定义SKIPLIST_ENABLE_TRACEPOINTS后，SKIPLIST_TRACEPOINT(name, args...)在调用处
+ * 生成一条nop，并在.note.stapsdt段中登记探针名"skiplist:name"及参数位置，
+ * 未挂载时只多一条nop；不定义时展开为空语句，参数不求值。
+ * 也可以在包含本文件前自行定义SKIPLIST_TRACEPOINT，把探针接到自己的钩子上。
+ *
+ * 探针列表：
+ *   concurrent_add(list, height, size)           ConcurrentSkipList插入新节点
+ *   concurrent_remove(list, height, size)        ConcurrentSkipList删除节点
+ *   concurrent_grow_height(list, old, new)       head节点长高
+ *   recycler_release(recycler, nodes)            NodeRecycler开始批量释放节点
+ *   recycler_release_done(recycler, nodes)       批量释放结束
+ *   leveldb_insert(list, height, count)          SkipList::Insert
+ *   leveldb_delete(list, height, count)          SkipList::Delete
+ *   leveldb_grow_height(list, old, new)          SkipList最大高度增加
+ *   tlsf_add_pool(pool, size, num_pools)         MemoryPoolTLSF扩容
+ *
+ * 例如：
+ *   bpftrace -e 'usdt:./skiplist_bench:skiplist:tlsf_add_pool { printf("%d\n", arg1); }'
+ */
+
+#if !defined(SKIPLIST_TRACEPOINT)
+#if defined(SKIPLIST_ENABLE_TRACEPOINTS) && defined(__ELF__) && \
+    defined(__x86_64__)
+
+// The note layout is the one <sys/sdt.h> emits (stapsdt note type 3), so the
+// usual tools find the probes without the systemtap headers installed.  An
+// argument is described as "<size>@<operand>", negative sizes are signed.
+#define SKIPLIST_SDT_SIZE(x)                                          \
+  (std::is_signed<typename std::decay<decltype(x)>::type>::value      \
+       ? -static_cast<int>(sizeof(x))                                 \
+       : static_cast<int>(sizeof(x)))
+
+#define SKIPLIST_SDT_OPERAND(n, x) [S##n] "n"(SKIPLIST_SDT_SIZE(x)), [A##n] "nor"(x)
+
+#define SKIPLIST_SDT_PROBE(name, args, ...)                                 \
+  __asm__ __volatile__(                                                     \
+      "990: nop\n"                                                          \
+      ".pushsection .note.stapsdt,\"?\",\"note\"\n"                         \
+      ".balign 4\n"                                                         \
+      ".4byte 992f-991f, 994f-993f, 3\n"                                    \
+      "991: .asciz \"stapsdt\"\n"                                           \
+      "992: .balign 4\n"                                                    \
+      "993: .8byte 990b\n"                                                  \
+      ".8byte _.stapsdt.base\n"                                             \
+      ".8byte 0\n"                                                          \
+      ".asciz \"skiplist\"\n"                                               \
+      ".asciz \"" #name "\"\n"                                              \
+      ".asciz \"" args "\"\n"                                               \
+      "994: .balign 4\n"                                                    \
+      ".popsection\n"                                                       \
+      ".ifndef _.stapsdt.base\n"                                            \
+      ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+      ".weak _.stapsdt.base\n"                                              \
+      ".hidden _.stapsdt.base\n"                                            \
+      "_.stapsdt.base: .space 1\n"                                          \
+      ".size _.stapsdt.base, 1\n"                                           \
+      ".popsection\n"                                                       \
+      ".endif\n"                                                            \
+      :                                                                     \
+      : __VA_ARGS__)
+
+#define SKIPLIST_SDT_1(name, a1) \
+  SKIPLIST_SDT_PROBE(name, "%c[S1]@%[A1]", SKIPLIST_SDT_OPERAND(1, a1))
+#define SKIPLIST_SDT_2(name, a1, a2)                         \
+  SKIPLIST_SDT_PROBE(name, "%c[S1]@%[A1] %c[S2]@%[A2]",      \
+                     SKIPLIST_SDT_OPERAND(1, a1),            \
+                     SKIPLIST_SDT_OPERAND(2, a2))
+#define SKIPLIST_SDT_3(name, a1, a2, a3)                              \
+  SKIPLIST_SDT_PROBE(name, "%c[S1]@%[A1] %c[S2]@%[A2] %c[S3]@%[A3]",  \
+                     SKIPLIST_SDT_OPERAND(1, a1),                     \
+                     SKIPLIST_SDT_OPERAND(2, a2),                     \
+                     SKIPLIST_SDT_OPERAND(3, a3))
+
+#define SKIPLIST_SDT_NARG(...) SKIPLIST_SDT_NARG_(__VA_ARGS__, 3, 2, 1, 0)
+#define SKIPLIST_SDT_NARG_(_1, _2, _3, N, ...) N
+#define SKIPLIST_SDT_CAT(a, b) SKIPLIST_SDT_CAT_(a, b)
+#define SKIPLIST_SDT_CAT_(a, b) a##b
+
+#define SKIPLIST_TRACEPOINT(name, ...)                                     \
+  SKIPLIST_SDT_CAT(SKIPLIST_SDT_, SKIPLIST_SDT_NARG(__VA_ARGS__))(name,    \
+                                                                __VA_ARGS__)
+
+#else
+
+#define SKIPLIST_TRACEPOINT(name, ...) \
+  do {                                 \
+  } while (false)
+
+#endif
+#endif
@@ -0,0 +1,189 @@
+#ifndef STORAGE_LEVELDB_DB_EPOCH_H_
+#define STORAGE_LEVELDB_DB_EPOCH_H_
+
+#include <atomic>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief 基于epoch的延迟回收，使SkipList::Delete()可以与无锁的读并发执行
+ *
+ * 读线程在访问跳表期间持有一个EpochGuard：进入时把当前epoch写入本线程的槽位，
+ * 退出时清零，只是一次thread-local的store，不需要原子读改写，也不需要内存屏障。
+ * 写线程删除节点后并不立即释放，而是先放入待回收列表；攒够一批后推进全局epoch，
+ * 用一次重量级屏障（Linux上为membarrier）代替所有读线程的屏障，再扫描各线程的槽位，
+ * 只有所有仍在读的线程都已进入更新的epoch时，才把节点交还给分配器（如MemoryPoolTLSF）。
+ * 进程内所有SkipList共用一个EpochDomain，一个EpochGuard对所有跳表都有效。
+ */
+
+namespace utility {
+namespace skiplist {
+
+class EpochDomain {
+ public:
+  // The process-wide domain.  Never destroyed, threads may still release
+  // their slots during exit.
+  static EpochDomain& Instance() {
+    static EpochDomain* domain = new EpochDomain();
+    return *domain;
+  }
+
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  // Reader side, see EpochGuard.  Guards nest.
+  void Enter() {
+    Slot* slot = LocalSlot();
+    if (slot->depth++ == 0) {
+      slot->epoch.store(epoch_.load(std::memory_order_acquire),
+                        std::memory_order_relaxed);
+      // The announcement must be visible before the reader loads a link;
+      // OldestReader() supplies the other half of the barrier.
+      LightBarrier();
+    }
+  }
+
+  void Exit() {
+    Slot* slot = LocalSlot();
+    if (--slot->depth == 0) {
+      slot->epoch.store(0, std::memory_order_release);
+    }
+  }
+
+  // Writer side.  Starts a new epoch and returns it: a reader that enters
+  // from now on sees every node unlinked before the call, so a node retired
+  // before it may be freed once OldestReader() is at least the returned
+  // epoch.
+  uint64_t Advance() {
+    return epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+  }
+
+  // The oldest epoch a reader is still in, UINT64_MAX if no thread is
+  // inside a guard.  Readers that enter concurrently are not counted: the
+  // barrier guarantees they already see the unlinked state.
+  uint64_t OldestReader() {
+    HeavyBarrier();
+    uint64_t oldest = UINT64_MAX;
+    for (Slot* s = slots_.load(std::memory_order_acquire); s != nullptr;
+         s = s->next) {
+      uint64_t epoch = s->epoch.load(std::memory_order_acquire);
+      if (epoch != 0 && epoch < oldest) {
+        oldest = epoch;
+      }
+    }
+    return oldest;
+  }
+
+ private:
+  enum { kCacheLineSize = 64 };
+
+  // One per thread that ever entered a guard, reused after the thread
+  // exits.  Plain new only aligns a slot to 16 bytes, so it is padded to
+  // two cache lines: the epochs of two readers, which start their own
+  // allocations, are then at least that far apart and never share a line.
+  struct Slot {
+    std::atomic<uint64_t> epoch;  // 0 outside of any guard
+    Slot* next;
+    int depth;  // owned by the thread using the slot
+    std::atomic<bool> in_use;
+    char padding[2 * kCacheLineSize - sizeof(std::atomic<uint64_t>) -
+                 sizeof(Slot*) - sizeof(int) - sizeof(std::atomic<bool>)];
+  };
+  static_assert(sizeof(Slot) % kCacheLineSize == 0 &&
+                    sizeof(Slot) >= 2 * kCacheLineSize,
+                "Slot must span two whole cache lines");
+
+  // Gives the slot of a thread back when the thread exits.
+  struct SlotHolder {
+    Slot* slot = nullptr;
+    ~SlotHolder() {
+      if (slot != nullptr) {
+        slot->epoch.store(0, std::memory_order_release);
+        slot->depth = 0;
+        slot->in_use.store(false, std::memory_order_release);
+      }
+    }
+  };
+
+  EpochDomain() : epoch_(1), slots_(nullptr), asymmetric_(false) {
+#if defined(__linux__) && defined(__NR_membarrier) && \
+    !defined(__SANITIZE_THREAD__)
+    // MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, Linux 4.14 and later
+    asymmetric_ = syscall(__NR_membarrier, 1 << 4, 0) == 0;
+#endif
+  }
+
+  Slot* LocalSlot() {
+    static thread_local SlotHolder holder;
+    if (holder.slot == nullptr) {
+      holder.slot = AcquireSlot();
+    }
+    return holder.slot;
+  }
+
+  Slot* AcquireSlot() {
+    for (Slot* s = slots_.load(std::memory_order_acquire); s != nullptr;
+         s = s->next) {
+      bool expected = false;
+      if (!s->in_use.load(std::memory_order_relaxed) &&
+          s->in_use.compare_exchange_strong(expected, true)) {
+        return s;
+      }
+    }
+    Slot* s = new Slot;
+    s->epoch.store(0, std::memory_order_relaxed);
+    s->in_use.store(true, std::memory_order_relaxed);
+    s->depth = 0;
+    s->next = slots_.load(std::memory_order_relaxed);
+    while (!slots_.compare_exchange_weak(s->next, s)) {
+    }
+    return s;
+  }
+
+  // With membarrier the readers only need to keep the compiler from
+  // reordering; otherwise both sides pay for a full fence.
+  void LightBarrier() const {
+    if (asymmetric_) {
+      std::atomic_signal_fence(std::memory_order_seq_cst);
+    } else {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+
+  void HeavyBarrier() const {
+#if defined(__linux__) && defined(__NR_membarrier)
+    // MEMBARRIER_CMD_PRIVATE_EXPEDITED: a full barrier on every running
+    // thread of the process.
+    if (asymmetric_ && syscall(__NR_membarrier, 1 << 3, 0) == 0) {
+      return;
+    }
+#endif
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  std::atomic<uint64_t> epoch_;
+  std::atomic<Slot*> slots_;
+  bool asymmetric_;
+};
+
+// Keeps the nodes a reader can reach from being freed by a concurrent
+// SkipList::Delete() while the guard lives.  Hold one around Contains(),
+// Find() and for as long as an Iterator is positioned or a returned key is
+// used.  Costs a thread-local store on entry and exit.
+class EpochGuard {
+ public:
+  EpochGuard() { EpochDomain::Instance().Enter(); }
+  ~EpochGuard() { EpochDomain::Instance().Exit(); }
+
+  EpochGuard(const EpochGuard&) = delete;
+  EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+} // namespace skiplist
+} // namespace utility
+
+#endif  // STORAGE_LEVELDB_DB_EPOCH_H_
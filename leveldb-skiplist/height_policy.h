@@ -0,0 +1,150 @@
+#ifndef STORAGE_LEVELDB_DB_HEIGHT_POLICY_H_
+#define STORAGE_LEVELDB_DB_HEIGHT_POLICY_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "random.h"
+
+/**
+ * @brief SkipList新节点高度的生成策略（SkipList的第六个模板参数）
+ *
+ * 每个策略提供：
+ *   enum { kBranching }               相邻两层的节点数之比，节点高度大于i的概率为kBranching^-i
+ *   enum { kMaxHeight }               节点高度的上限，即跳表的最大层数
+ *   explicit Policy(uint64_t stream)  stream为0的实例属于SkipList本身，
+ *                                     InsertConcurrently()的各线程依次使用1, 2, ...
+ *   int Height(int max_height)        返回[1, max_height]内的高度
+ *
+ * ModuloHeight        默认策略，与leveldb原来的行为一致：Park-Miller随机数，每升一层取一次模
+ * TrailingZerosHeight 每次插入只取一个64位随机数，由末尾0的个数直接得到高度，
+ *                     kBranching必须是2的幂
+ * 模板参数MaxHeight默认取能容纳约2^32个节点的层数（kBranching为4时是17），
+ * 跳表头节点只按实际出现的最高节点增长，上限大并不占用额外内存。
+ * 模板参数Seed为kRandomSeed时，每个跳表的种子取自时钟，各次运行的高度不同；
+ * 其他值则完全确定，便于复现benchmark。
+ */
+
+namespace utility {
+namespace skiplist {
+
+// Seed that asks a height policy for a different sequence on every run.
+static const uint64_t kRandomSeed = 0;
+
+namespace height_policy {
+
+inline uint64_t SplitMix64(uint64_t* state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// The seed of the generator of the given stream, see the file comment.
+inline uint64_t StreamSeed(uint64_t seed, uint64_t stream) {
+  if (seed == kRandomSeed) {
+    static std::atomic<uint64_t> lists(0);
+    seed = static_cast<uint64_t>(
+               std::chrono::steady_clock::now().time_since_epoch().count()) ^
+           lists.fetch_add(1, std::memory_order_relaxed);
+    SplitMix64(&seed);
+  }
+  return seed + stream * 0x9e3779b9u;
+}
+
+// REQUIRES: x != 0
+inline int CountTrailingZeros(uint64_t x) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(x);
+#endif
+}
+
+constexpr int Log2(int n) { return n <= 1 ? 0 : 1 + Log2(n / 2); }
+
+// The number of levels that keep a search logarithmic over entries keys.
+constexpr int LevelsFor(uint64_t entries, uint64_t branching) {
+  return entries <= 1
+             ? 1
+             : 1 + LevelsFor((entries + branching - 1) / branching, branching);
+}
+
+static const uint64_t kDefaultCapacity = 1ull << 32;
+
+} // namespace height_policy
+
+// Raises the height with probability 1 in Branching, one draw at a time.
+// With the default arguments the list of stream 0 gets exactly the
+// heights leveldb's SkipList generated, up to its old cap of 12.
+template <int Branching = 4, uint64_t Seed = 0xdeadbeef,
+          int MaxHeight = height_policy::LevelsFor(
+              height_policy::kDefaultCapacity, Branching)>
+class ModuloHeight {
+  static_assert(Branching >= 2, "Branching must be at least 2");
+  static_assert(MaxHeight >= 1 && MaxHeight <= 64,
+                "MaxHeight must be in [1, 64]");
+
+ public:
+  enum { kBranching = Branching };
+  enum { kMaxHeight = MaxHeight };
+
+  explicit ModuloHeight(uint64_t stream)
+      : rnd_(static_cast<uint32_t>(
+            height_policy::StreamSeed(Seed, stream))) {}
+
+  int Height(int max_height) {
+    int height = 1;
+    while (height < max_height && ((rnd_.Next() % kBranching) == 0)) {
+      height++;
+    }
+    return height;
+  }
+
+ private:
+  Random rnd_;
+};
+
+// Every trailing zero bit of a single 64-bit draw is a coin flip with
+// probability 1/2, so log2(Branching) of them in a row make one level.
+template <int Branching = 4, uint64_t Seed = kRandomSeed,
+          int MaxHeight = height_policy::LevelsFor(
+              height_policy::kDefaultCapacity, Branching)>
+class TrailingZerosHeight {
+  static_assert(Branching >= 2 && (Branching & (Branching - 1)) == 0,
+                "Branching must be a power of two");
+  static_assert(MaxHeight >= 1 && MaxHeight <= 64,
+                "MaxHeight must be in [1, 64]");
+
+ public:
+  enum { kBranching = Branching };
+  enum { kMaxHeight = MaxHeight };
+
+  explicit TrailingZerosHeight(uint64_t stream)
+      : state_(height_policy::StreamSeed(Seed, stream)) {}
+
+  int Height(int max_height) {
+    // The top bit caps the zeros at 63, which is out of reach of any
+    // max_height anyway.
+    uint64_t bits = height_policy::SplitMix64(&state_) | (1ull << 63);
+    int height = 1 + height_policy::CountTrailingZeros(bits) / kLevelBits;
+    return height < max_height ? height : max_height;
+  }
+
+ private:
+  enum { kLevelBits = height_policy::Log2(Branching) };
+
+  uint64_t state_;
+};
+
+} // namespace skiplist
+} // namespace utility
+
+#endif  // STORAGE_LEVELDB_DB_HEIGHT_POLICY_H_
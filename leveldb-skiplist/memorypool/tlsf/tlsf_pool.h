@@ -1,14 +1,18 @@
 #pragma once
 
 #include "tlsf.h"
+#include "../../../concurrent-skiplist/static_tracepoint.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
 #include <iostream>
 #include <vector>
 #include <cassert>
 
 /**
  * @brief 封装的tlsf内存池，构造时指定预分配的大小，默认为256K，增长速率为1.5
+ *        stats()遍历所有pool统计占用/空闲字节、空闲块分布和外部碎片率
  */
 
 namespace utility {
@@ -17,6 +21,34 @@ namespace memorypool {
 typedef char* PoolTypeStr;
 typedef char PoolType;
 
+// Occupancy of a MemoryPoolTLSF, as returned by MemoryPoolTLSF::stats().
+// Byte counts are block payloads, i.e. they exclude the tlsf block headers.
+struct TLSFPoolStats {
+    struct Pool {
+        size_t used_bytes = 0;
+        size_t free_bytes = 0;
+        size_t used_blocks = 0;
+        size_t free_blocks = 0;
+        size_t largest_free_block = 0;
+    };
+
+    // Free blocks whose size falls in [2^i, 2^(i+1)) are counted in
+    // free_block_histogram[i].
+    static const int kHistogramBuckets = 64;
+
+    std::vector<Pool> pools;   // in the order addPool() created them
+    size_t used_bytes = 0;
+    size_t free_bytes = 0;
+    size_t used_blocks = 0;
+    size_t free_blocks = 0;
+    size_t largest_free_block = 0;
+    size_t free_block_histogram[kHistogramBuckets] = {};
+
+    // External fragmentation, 1 - largest_free_block / free_bytes: 0 when all
+    // free memory is one block, close to 1 when it is scattered in crumbs.
+    double fragmentation = 0;
+};
+
 class MemoryPoolTLSF {
 public:
     MemoryPoolTLSF(size_t size = 256 * 1024)
@@ -44,34 +76,140 @@ public:
                 return nullptr;
             }
         }
+        if (ptr) {
+            used_bytes_ += tlsf_block_size(ptr);
+            ++used_blocks_;
+        }
         return ptr;
     }
 
     void free(void* ptr) {
+        if (ptr) {
+            used_bytes_ -= tlsf_block_size(ptr);
+            --used_blocks_;
+        }
         tlsf_free(tlsf_, ptr);
     }
 
+    // Frees every block at once by rebuilding the tlsf control structure over
+    // the pools already allocated, O(number of pools).  The pools are kept,
+    // so refilling the pool does not go back to the system allocator.
+    // REQUIRES: no block handed out so far is used any more.
+    void reset() {
+        if (pools_.empty()) {
+            return;
+        }
+        tlsf_destroy(tlsf_);
+        tlsf_ = tlsf_create_with_pool(pools_[0], pool_bytes_[0]);
+        tlsf_pools_.clear();
+        tlsf_pools_.emplace_back(tlsf_get_pool(tlsf_));
+        for (size_t i = 1; i < pools_.size(); ++i) {
+            pool_t added = tlsf_add_pool(tlsf_, pools_[i], pool_bytes_[i]);
+            if (added) {
+                tlsf_pools_.emplace_back(added);
+            }
+        }
+        used_bytes_ = 0;
+        used_blocks_ = 0;
+    }
+
+    // O(1) counters, kept up to date by malloc() and free().
+    size_t usedBytes() const { return used_bytes_; }
+    size_t usedBlocks() const { return used_blocks_; }
+    size_t numPools() const { return tlsf_pools_.size(); }
+
+    // Walks every block of every pool, O(number of blocks).  Not thread-safe,
+    // the caller must hold whatever lock guards malloc() and free().
+    TLSFPoolStats stats() const {
+        TLSFPoolStats result;
+        result.pools.resize(tlsf_pools_.size());
+        for (size_t i = 0; i < tlsf_pools_.size(); ++i) {
+            Walk walk = {&result, &result.pools[i]};
+            tlsf_walk_pool(tlsf_pools_[i], &MemoryPoolTLSF::walker, &walk);
+        }
+        if (result.free_bytes > 0) {
+            result.fragmentation = 1.0 -
+                static_cast<double>(result.largest_free_block) / result.free_bytes;
+        }
+        return result;
+    }
+
+    void printStats() const {
+        TLSFPoolStats s = stats();
+        printf("MemoryPoolTLSF: pools=%zu used=%zu/%zu blocks free=%zu/%zu blocks "
+               "largest_free=%zu fragmentation=%.3f\n",
+               s.pools.size(), s.used_bytes, s.used_blocks, s.free_bytes,
+               s.free_blocks, s.largest_free_block, s.fragmentation);
+        for (size_t i = 0; i < s.pools.size(); ++i) {
+            const TLSFPoolStats::Pool& p = s.pools[i];
+            printf("  pool %zu: used=%zu/%zu blocks free=%zu/%zu blocks "
+                   "largest_free=%zu\n",
+                   i, p.used_bytes, p.used_blocks, p.free_bytes, p.free_blocks,
+                   p.largest_free_block);
+        }
+        for (int i = 0; i < TLSFPoolStats::kHistogramBuckets; ++i) {
+            if (s.free_block_histogram[i] != 0) {
+                printf("  free [%zu, %zu): %zu\n", size_t(1) << i,
+                       size_t(1) << (i + 1), s.free_block_histogram[i]);
+            }
+        }
+    }
+
     MemoryPoolTLSF(const MemoryPoolTLSF&) = delete;
     MemoryPoolTLSF& operator=(const MemoryPoolTLSF&) = delete;
 
 private:
+    struct Walk {
+        TLSFPoolStats* stats;
+        TLSFPoolStats::Pool* pool;
+    };
+
+    static void walker(void* ptr, size_t size, int used, void* user) {
+        (void)ptr;
+        Walk* walk = static_cast<Walk*>(user);
+        if (used) {
+            walk->pool->used_bytes += size;
+            ++walk->pool->used_blocks;
+            walk->stats->used_bytes += size;
+            ++walk->stats->used_blocks;
+            return;
+        }
+        walk->pool->free_bytes += size;
+        ++walk->pool->free_blocks;
+        walk->pool->largest_free_block =
+            std::max(walk->pool->largest_free_block, size);
+        walk->stats->free_bytes += size;
+        ++walk->stats->free_blocks;
+        walk->stats->largest_free_block =
+            std::max(walk->stats->largest_free_block, size);
+        if (size > 0) {
+            int bucket = 63 - __builtin_clzll(static_cast<unsigned long long>(size));
+            ++walk->stats->free_block_histogram[bucket];
+        }
+    }
+
     bool addPool(size_t size) {
         size_t total_size = cur_pool_size_ 
                             + tlsf_size() 
                             + tlsf_pool_overhead()
                             + tlsf_alloc_overhead();
-        printf("begin add pool, size:%d\n", size);
         void* pool = ::malloc(total_size);
         if (pool) {
             if (cur_pool_size_ == initial_size_) {
-                printf("Firstly create tlsf pool, size: %d\n", size);
                 tlsf_ = tlsf_create_with_pool(pool, total_size);
+                tlsf_pools_.emplace_back(tlsf_get_pool(tlsf_));
+                pool_bytes_.emplace_back(total_size);
             }
             else {
-                tlsf_add_pool(tlsf_, pool, cur_pool_size_);
+                pool_t added = tlsf_add_pool(tlsf_, pool, cur_pool_size_);
+                if (added) {
+                    tlsf_pools_.emplace_back(added);
+                }
+                pool_bytes_.emplace_back(cur_pool_size_);
             }
 
             pools_.emplace_back(pool);
+            SKIPLIST_TRACEPOINT(tlsf_add_pool, this, cur_pool_size_, pools_.size());
             cur_pool_size_ = static_cast<size_t>(cur_pool_size_ * INC_RATIO);
             return true;
         }
@@ -88,6 +226,10 @@ private:
     const double INC_RATIO = 1.5;
 
     std::vector<void*> pools_;
+    std::vector<size_t> pool_bytes_;  // what tlsf was given of pools_[i]
+    std::vector<pool_t> tlsf_pools_;
+    size_t used_bytes_ = 0;
+    size_t used_blocks_ = 0;
 };
 
 } // namespace memorypool
@@ -0,0 +1,255 @@
+#ifndef STORAGE_LEVELDB_DB_NODE_ALLOCATOR_H_
+#define STORAGE_LEVELDB_DB_NODE_ALLOCATOR_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define SKIPLIST_HAS_PMR 1
+#endif
+#endif
+
+#include "memorypool/arena/arena.h"
+#include "memorypool/tlsf/tlsf_pool.h"
+
+/**
+ * @brief SkipList的节点内存分配策略（SkipList的第三个模板参数）
+ *
+ * 每个策略提供：
+ *   void* Allocate(size, align)           分配一个节点
+ *   void Deallocate(p, size, align)       释放Delete()摘下的节点
+ *   size_t AllocatedSize(p, size) const   该节点实际占用的字节数，用于内存统计
+ *   bool ReleaseAll()                     一次性释放所有已分配的节点，做不到时返回false
+ *
+ * TLSFAllocator   默认策略，MemoryPoolTLSF*为空时退回malloc，与原先的行为一致
+ * MallocAllocator malloc/free
+ * ArenaAllocator  leveldb Arena，分配只移动指针，Deallocate为空操作，适合只插入的memtable
+ * PmrAllocator    std::pmr::memory_resource，仅C++17
+ * SynchronizedAllocator<A>  用自旋锁串行化对A的调用，供SkipList::InsertConcurrently()
+ *                 使用TLSF/Arena这类非线程安全的策略
+ * 策略对象按值（移动）保存在SkipList中。TLSF/Arena策略默认不拥有底层的内存池，
+ * 由Owning()创建的策略独占一个私有的内存池，此时SkipList::Clear()和析构无需逐个
+ * 释放节点，ReleaseAll()直接重置整个内存池。
+ */
+
+namespace utility {
+namespace skiplist {
+
+using memorypool::Arena;
+using memorypool::MemoryPoolTLSF;
+
+class MallocAllocator {
+ public:
+  void* Allocate(size_t size, size_t align) {
+    assert(align <= alignof(std::max_align_t));
+    (void)align;
+    return malloc(size);
+  }
+
+  void Deallocate(void* p, size_t, size_t) { free(p); }
+
+  bool ReleaseAll() { return false; }
+
+  size_t AllocatedSize(void* p, size_t size) const {
+#if defined(__GLIBC__)
+    // usable size plus the chunk header in front of it
+    (void)size;
+    return malloc_usable_size(p) + sizeof(size_t);
+#else
+    (void)p;
+    return size;
+#endif
+  }
+};
+
+// Implicitly constructible from MemoryPoolTLSF*, so SkipList(cmp, tlsf)
+// keeps working.  A null pool allocates with malloc.
+class TLSFAllocator {
+ public:
+  TLSFAllocator(MemoryPoolTLSF* tlsf = nullptr) : tlsf_(tlsf) {}
+
+  // An allocator with a pool of its own, that nobody else allocates from.
+  static TLSFAllocator Owning(size_t pool_size = 256 * 1024) {
+    TLSFAllocator allocator(new MemoryPoolTLSF(pool_size));
+    allocator.owned_.reset(allocator.tlsf_);
+    return allocator;
+  }
+
+  void* Allocate(size_t size, size_t align) {
+    if (tlsf_ == nullptr) {
+      return malloc_.Allocate(size, align);
+    }
+    // tlsf blocks are aligned to the pointer size
+    assert(align <= sizeof(void*));
+    return tlsf_->malloc(size);
+  }
+
+  void Deallocate(void* p, size_t size, size_t align) {
+    if (tlsf_ == nullptr) {
+      malloc_.Deallocate(p, size, align);
+    } else {
+      tlsf_->free(p);
+    }
+  }
+
+  size_t AllocatedSize(void* p, size_t size) const {
+    if (tlsf_ == nullptr) {
+      return malloc_.AllocatedSize(p, size);
+    }
+    return tlsf_block_size(p) + tlsf_alloc_overhead();
+  }
+
+  // Only an Owning() allocator knows that every block in its pool is a node.
+  bool ReleaseAll() {
+    if (!owned_) {
+      return false;
+    }
+    owned_->reset();
+    return true;
+  }
+
+  MemoryPoolTLSF* pool() const { return tlsf_; }
+
+ private:
+  MemoryPoolTLSF* tlsf_;
+  std::unique_ptr<MemoryPoolTLSF> owned_;
+  MallocAllocator malloc_;
+};
+
+// Nodes are never given back: Deallocate() is a no-op and the memory of
+// deleted nodes is only reclaimed when the Arena is destroyed.
+class ArenaAllocator {
+ public:
+  ArenaAllocator(Arena* arena) : arena_(arena) {}
+
+  // An allocator with an arena of its own.
+  static ArenaAllocator Owning(size_t block_size = 4096) {
+    ArenaAllocator allocator(new Arena(block_size));
+    allocator.owned_.reset(allocator.arena_);
+    return allocator;
+  }
+
+  void* Allocate(size_t size, size_t align) {
+    return arena_->AllocateAligned(size, align);
+  }
+
+  void Deallocate(void*, size_t, size_t) {}
+
+  size_t AllocatedSize(void*, size_t size) const { return size; }
+
+  bool ReleaseAll() {
+    if (!owned_) {
+      return false;
+    }
+    owned_->Reset();
+    return true;
+  }
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+  std::unique_ptr<Arena> owned_;
+};
+
+#if SKIPLIST_HAS_PMR
+// Allocates from a std::pmr::memory_resource, e.g. a
+// monotonic_buffer_resource per request or an unsynchronized_pool_resource.
+class PmrAllocator {
+ public:
+  PmrAllocator(std::pmr::memory_resource* resource =
+                   std::pmr::get_default_resource())
+      : resource_(resource) {}
+
+  void* Allocate(size_t size, size_t align) {
+    return resource_->allocate(size, align);
+  }
+
+  void Deallocate(void* p, size_t size, size_t align) {
+    resource_->deallocate(p, size, align);
+  }
+
+  size_t AllocatedSize(void*, size_t size) const { return size; }
+
+  bool ReleaseAll() { return false; }
+
+  std::pmr::memory_resource* resource() const { return resource_; }
+
+ private:
+  std::pmr::memory_resource* resource_;
+};
+#endif
+
+// Serializes every call into another policy with a spin lock, so that
+// SkipList::InsertConcurrently() can allocate from a pool or an arena that
+// is not thread-safe.  Only the allocation is serialized, the search and
+// the linking stay lock-free.
+template <class Allocator>
+class SynchronizedAllocator {
+ public:
+  SynchronizedAllocator(Allocator allocator = Allocator())
+      : allocator_(std::move(allocator)), locked_(false) {}
+
+  // The lock is not moved, a moved-to allocator starts unlocked.
+  SynchronizedAllocator(SynchronizedAllocator&& other)
+      : allocator_(std::move(other.allocator_)), locked_(false) {}
+
+  void* Allocate(size_t size, size_t align) {
+    Guard guard(this);
+    return allocator_.Allocate(size, align);
+  }
+
+  void Deallocate(void* p, size_t size, size_t align) {
+    Guard guard(this);
+    allocator_.Deallocate(p, size, align);
+  }
+
+  // Locked too: tlsf keeps the free bit of the previous block in the size
+  // word of this one.
+  size_t AllocatedSize(void* p, size_t size) const {
+    Guard guard(this);
+    return allocator_.AllocatedSize(p, size);
+  }
+
+  bool ReleaseAll() {
+    Guard guard(this);
+    return allocator_.ReleaseAll();
+  }
+
+  const Allocator& allocator() const { return allocator_; }
+
+ private:
+  class Guard {
+   public:
+    explicit Guard(const SynchronizedAllocator* owner) : owner_(owner) {
+      while (owner_->locked_.exchange(true, std::memory_order_acquire)) {
+        while (owner_->locked_.load(std::memory_order_relaxed)) {
+          std::this_thread::yield();
+        }
+      }
+    }
+    ~Guard() { owner_->locked_.store(false, std::memory_order_release); }
+
+   private:
+    const SynchronizedAllocator* owner_;
+  };
+
+  Allocator allocator_;
+  mutable std::atomic<bool> locked_;
+};
+
+} // namespace skiplist
+} // namespace utility
+
+#endif  // STORAGE_LEVELDB_DB_NODE_ALLOCATOR_H_
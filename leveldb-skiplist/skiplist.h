@@ -9,34 +9,65 @@
 // -------------
 //
 // Writes require external synchronization, most likely a mutex.
+// The one exception is InsertConcurrently(), which may be called from
+// several threads at once with no lock, as long as no other kind of write
+// runs at the same time.
 // Reads require a guarantee that the SkipList will not be destroyed
-// while the read is in progress.  Apart from that, reads progress
+// while the read is in progress, and an EpochGuard (epoch.h) if they can
+// run concurrently with Delete().  Apart from that, reads progress
 // without any internal locking or synchronization.
 //
 // Invariants:
 //
-// (1) Allocated nodes are never deleted until the SkipList is
-// destroyed.  This is trivially guaranteed by the code since we
-// never delete any skip list nodes.
+// (1) A node is not freed while a reader can reach it.  Delete()
+// unlinks the node and retires it; retired nodes are handed back to
+// the allocator in batches, once every reader inside an EpochGuard
+// has entered an epoch that started after the unlink.
 //
 // (2) The contents of a Node except for the next/prev pointers are
 // immutable after the Node has been linked into the SkipList.
 // Only Insert() modifies the list, and it is careful to initialize
 // a node and use release-stores to publish the nodes in one or
-// more lists.
+// more lists.  InsertConcurrently() publishes with a CAS instead,
+// from the bottom level up, so a node reachable on level i is
+// already linked on every level below i.
 //
-// ... prev vs. next pointer ordering ...
+// (3) With PrevLinks, a node's backward link is set before the node is
+// published on level 0, and the backward link of its successor (of
+// head_ for the last node) is moved to it afterwards.  The first node
+// links back to nullptr, never to head_.  A reader moving backwards
+// may miss a node that is being inserted, just like a reader moving
+// forwards that already passed its predecessor.
+//
+// (4) With Indexed, the spans are plain counters maintained by the
+// writer.  A reader running Rank() or Select() next to a write may
+// be off by the nodes being inserted or deleted, but never follows a
+// link that is not safe to follow.
+//
+// (5) head_ starts at kInitialHeight levels and grows only as tall as
+// the tallest node linked so far.  A taller node makes Insert() publish
+// a taller copy of the head before raising max_height_, and retire the
+// old head like a deleted node.  Readers load max_height_ first, so the
+// head they then load is tall enough for it.
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstdlib>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-#include "random.h"
-#include "memorypool/tlsf/tlsf_pool.h"
+#include "epoch.h"
+#include "height_policy.h"
+#include "node_allocator.h"
+#include "slice.h"
+#include "../concurrent-skiplist/static_tracepoint.h"
 
 
 /**
- * @brief 支持删除操作，内存分配改为tlsf
+ * @brief 支持删除操作，节点内存分配策略可替换（见node_allocator.h），默认为tlsf
  */
 
 namespace utility {
@@ -44,36 +75,266 @@ namespace skiplist {
 
 using namespace memorypool;
 
-template <typename Key, class Comparator>
-class SkipList {
+// How a SkipList node stores its key.  By default the node holds a copy of
+// the Key object.  A specialization can ask for ExtraBytes(key) more bytes
+// after the next_[] tower of the node and Place() data there, returning the
+// Key the node holds instead.  HeadKey() is the key of the head node.
+template <typename Key>
+struct SkipListKeyTraits {
+  static Key HeadKey() { return 0; }
+  static size_t ExtraBytes(const Key&) { return 0; }
+  static Key Place(const Key& key, char*) { return key; }
+};
+
+// Slice keys are copied inline, right after the tower, so that comparing
+// against a node reads the allocation the search just loaded the link from
+// instead of chasing a pointer to the caller's bytes.
+template <>
+struct SkipListKeyTraits<Slice> {
+  static Slice HeadKey() { return Slice(); }
+  static size_t ExtraBytes(const Slice& key) { return key.size(); }
+  static Slice Place(const Slice& key, char* dst) {
+    memcpy(dst, key.data(), key.size());
+    return Slice(dst, key.size());
+  }
+};
+
+// The backward link on level 0 of a SkipList node, empty without PrevLinks.
+template <typename Node, bool Enabled>
+struct SkipListPrevLink {
+  Node* Prev() { return nullptr; }
+  void SetPrev(Node*) {}
+  void NoBarrier_SetPrev(Node*) {}
+};
+
+template <typename Node>
+struct SkipListPrevLink<Node, true> {
+  // Same barriers as Node::Next() and Node::SetNext().
+  Node* Prev() { return prev_.load(std::memory_order_acquire); }
+  void SetPrev(Node* x) { prev_.store(x, std::memory_order_release); }
+  void NoBarrier_SetPrev(Node* x) {
+    prev_.store(x, std::memory_order_relaxed);
+  }
+
  private:
-  struct Node;
+  std::atomic<Node*> prev_;
+};
 
- public:
-  // Create a new SkipList object that will use "cmp" for comparing keys,
-  // and will allocate memory using "*arena".  Objects allocated in the arena
-  // must remain allocated for the lifetime of the skiplist object.
+// One entry of a node's tower: the link, and with Indexed the number of
+// level-0 steps it skips (its span).  The span of a nullptr link is
+// meaningless.
+template <typename Node, bool Indexed>
+struct SkipListLink {
+  size_t Span() const { return 0; }
+  void SetSpan(size_t) {}
 
+  std::atomic<Node*> next;
+};
 
-  // explicit SkipList(Comparator cmp, Arena* arena);
+template <typename Node>
+struct SkipListLink<Node, true> {
+  size_t Span() const { return span.load(std::memory_order_relaxed); }
+  void SetSpan(size_t n) { span.store(n, std::memory_order_relaxed); }
 
-  explicit SkipList(Comparator cmp, MemoryPoolTLSF* tlsf);
+  std::atomic<Node*> next;
+  std::atomic<size_t> span;
+};
+
+// With PrevLinks every node also links back to its predecessor on level 0,
+// one more pointer per node, and head_ links back to the last node:
+// Iterator::Prev() and SeekToLast() are then O(1) instead of a search from
+// head_.
+//
+// With Indexed every link also counts the nodes it skips, one more word per
+// link, which makes Rank(), Select(), CountRange() and
+// Iterator::SeekToIndex() O(log n).
+//
+// HeightPolicy draws the height of every new node and fixes kBranching,
+// see height_policy.h.
+template <typename Key, class Comparator, class Allocator = TLSFAllocator,
+          bool PrevLinks = false, bool Indexed = false,
+          class HeightPolicy = ModuloHeight<>>
+class SkipList {
+ private:
+  struct Node;
 
+ public:
+  // Create a new SkipList object that will use "cmp" for comparing keys,
+  // and will allocate nodes through "allocator".  The pool, arena or memory
+  // resource behind the allocator must outlive the skiplist object.
+  // SkipList(cmp, tlsf) with a MemoryPoolTLSF* (or nullptr for malloc)
+  // selects the default TLSFAllocator.
+  explicit SkipList(Comparator cmp, Allocator allocator = Allocator());
+
+  // Builds the list from [first, last), sorted in ascending order, in O(n);
+  // see Assign().
+  template <typename InputIt>
+  SkipList(Comparator cmp, InputIt first, InputIt last,
+           Allocator allocator = Allocator());
+
+  // Frees every node.  When the allocator owns its pool or arena
+  // (TLSFAllocator::Owning(), ArenaAllocator::Owning()) and Key is trivially
+  // destructible, the pool is released as a whole without visiting a single
+  // node; otherwise the nodes are freed one by one along level 0.
+  ~SkipList();
 
   SkipList(const SkipList&) = delete;
   SkipList& operator=(const SkipList&) = delete;
 
-  // Insert key into the list.
-  // REQUIRES: nothing that compares equal to key is currently in the list.
-  void Insert(const Key& key);
+  // Removes every key, at the same cost as the destructor.
+  // REQUIRES: no concurrent readers or writers.
+  void Clear();
+
+  // Replaces the contents with [first, last), which must be sorted in
+  // ascending order (repeated keys are dropped).  The nodes are appended in
+  // one pass, O(n), and the heights are not random but perfectly balanced:
+  // every kBranching-th node reaches level 2, every kBranching^2-th level 3,
+  // and so on, which bounds a search by kBranching nodes per level.
+  // REQUIRES: no concurrent readers or writers.
+  template <typename InputIt>
+  void Assign(InputIt first, InputIt last);
+
+  // Insert key into the list.  Returns false, leaving the list unchanged,
+  // if something that compares equal to key is already in it.
+  bool Insert(const Key& key);
+
+  // Inserts key unless an equal key is present, with a single search.
+  // Returns the entry in the list, the new one or the one that was there,
+  // and whether key was inserted.
+  std::pair<const Key*, bool> FindOrInsert(const Key& key);
+
+  // Like Insert(), but without external synchronization: any number of
+  // threads may call InsertConcurrently() at the same time, alongside
+  // readers.  Every level is linked with a CAS on the predecessor's link,
+  // bottom-up; a failed CAS re-searches that level from the same
+  // predecessor.  Of several threads inserting equal keys exactly one
+  // succeeds, the others return false.
+  // The head is never grown here: heights are capped at the current head
+  // height, which an empty list sets for about 64K keys, so call Reserve()
+  // before loading more keys concurrently.
+  // REQUIRES: no concurrent Insert(), InsertBatch(), Assign(), Delete() or
+  // Clear(), neither PrevLinks nor Indexed, and an allocator that is safe
+  // to call from several threads (MallocAllocator, TLSFAllocator without a
+  // pool, or any policy wrapped in SynchronizedAllocator).
+  bool InsertConcurrently(const Key& key);
+
+  // Grows the head tower to the height a list of expected_entries keys
+  // needs, which Insert() would otherwise reach one level at a time.
+  // REQUIRES: no concurrent writers.
+  void Reserve(size_t expected_entries);
+
+  // Returns the entry that compares equal to key, nullptr if there is none.
+  const Key* Find(const Key& key) const;
+
+  // Inserts the keys of [first, last), which must be sorted in ascending
+  // order, skipping those already in the list.  The splice (the predecessor
+  // on every level) of the previous key is kept: a key only re-searches the
+  // levels on which it moved past the cached successors, starting from the
+  // cached predecessor, so dense batches cost O(1) amortized per key instead
+  // of a search from head_.  Returns the number of keys inserted.
+  // REQUIRES: same external synchronization as Insert().
+  template <typename InputIt>
+  size_t InsertBatch(InputIt first, InputIt last);
 
   // 删除一个key
+  // The node is unlinked at once but freed later, when no reader inside an
+  // EpochGuard can still be on it, so readers holding a guard may run
+  // concurrently.  Writers still need external synchronization.
   bool Delete(const Key& key);
 
   // Returns true iff an entry that compares equal to key is in the list.
   bool Contains(const Key& key) const;
 
-  size_t size() { return count_; }
+  // Indexed lists only.  Like size(), the results are exact only while no
+  // write is running.
+  //
+  // The number of entries that compare less than key, i.e. the index key
+  // has or would have in the list.
+  size_t Rank(const Key& key) const;
+  // The entry at index (0-based), nullptr if index >= size().
+  const Key* Select(size_t index) const;
+  // The number of entries in [begin, end).
+  size_t CountRange(const Key& begin, const Key& end) const {
+    size_t first = Rank(begin);
+    size_t last = Rank(end);
+    return last > first ? last - first : 0;
+  }
+
+  // Estimates the number of entries in [begin, end) without visiting them:
+  // counts the range on the highest level where it spans at least
+  // min_samples nodes and scales by kBranching per level, level 0 being
+  // exact.  The relative error shrinks like 1/sqrt(min_samples) while the
+  // cost grows like log(n) + kBranching * min_samples.  Safe to call
+  // alongside writers, like Contains().
+  size_t ApproximateCount(const Key& begin, const Key& end,
+                          size_t min_samples = kApproximateSamples) const;
+
+  size_t size() { return count_.load(std::memory_order_relaxed); }
+
+  // Shape of the list, as returned by GetStructureStats().
+  struct StructureStats {
+    size_t num_nodes;
+    int max_height;  // current max_height_, at most the head height
+    // level_nodes[i] is the number of nodes linked on level i, i.e. with
+    // height > i.  ideal_level_nodes[i] = num_nodes / kBranching^i is what
+    // the random heights converge to.
+    std::vector<size_t> level_nodes;
+    std::vector<double> ideal_level_nodes;
+    // Half the summed |level_nodes - ideal_level_nodes| over the ideal link
+    // count: 0 for a perfectly shaped list, approaching 1 when all links sit
+    // on the wrong levels.
+    double shape_distance;
+    // Nodes visited by FindGreaterOrEqual() per search, over the sampled
+    // keys, in total and for every level (index 0 = bottom level).
+    size_t searches;
+    double avg_search_path;
+    size_t max_search_path;
+    std::vector<double> avg_level_visits;
+    // Expected search path of an ideally shaped list with the same number of
+    // nodes: kBranching * log_kBranching(n) + kBranching / (kBranching - 1).
+    double ideal_search_path;
+    // Comparator invocations per search.
+    double avg_comparisons;
+  };
+
+  // Walks every level and replays FindGreaterOrEqual() for every
+  // sample_stride-th key.  O(n + n/sample_stride * log n), meant for
+  // diagnostics.  Same requirements as a reader: no concurrent Delete().
+  StructureStats GetStructureStats(size_t sample_stride = 1) const;
+
+  // Memory held by the list, as returned by GetMemoryUsage().
+  struct MemoryUsage {
+    size_t num_nodes;
+    // height_nodes[h - 1] nodes of height h, taking height_bytes[h - 1]
+    // bytes: sizeof(Node) plus h - 1 extra links each.
+    std::vector<size_t> height_nodes;
+    std::vector<size_t> height_bytes;
+    size_t node_bytes;  // sum of height_bytes
+    size_t head_bytes;  // kInitialHeight links or the tallest node's
+    // Deleted nodes not freed yet because a reader may still be on them,
+    // with their allocator overhead.
+    size_t retired_nodes;
+    size_t retired_bytes;
+    // Key bytes stored inline after the towers of the linked nodes (Slice
+    // keys, see SkipListKeyTraits), 0 for other keys.
+    size_t key_bytes;
+    // Bytes the allocator takes on top of node_bytes + head_bytes +
+    // key_bytes: tlsf block headers and size rounding, or malloc chunk
+    // headers and rounding.
+    size_t allocator_overhead;
+    size_t total_bytes;
+  };
+
+  // O(kMaxHeight), from counters kept by Insert() and Delete().
+  MemoryUsage GetMemoryUsage() const;
+
+  // Every byte taken from the allocator for the list, O(1).  Like size(),
+  // it is only exact while no Insert() or Delete() is running.
+  size_t ApproximateMemoryUsage() const {
+    return allocated_bytes_.load(std::memory_order_relaxed);
+  }
+
+  const Allocator& allocator() const { return allocator_; }
 
   // Iteration over the contents of a skip list
   class Iterator {
@@ -93,7 +354,8 @@ class SkipList {
     // REQUIRES: Valid()
     void Next();
 
-    // Advances to the previous position.
+    // Advances to the previous position.  O(1) with PrevLinks, otherwise a
+    // search for the last key before the current one.
     // REQUIRES: Valid()
     void Prev();
 
@@ -108,6 +370,11 @@ class SkipList {
     // Final state of iterator is Valid() iff list is not empty.
     void SeekToLast();
 
+    // Position at the entry at index (0-based), like Select().
+    // Final state of iterator is Valid() iff index < size().
+    // REQUIRES: Indexed
+    void SeekToIndex(size_t index);
+
    private:
     const SkipList* list_;
     Node* node_;
@@ -115,18 +382,75 @@ class SkipList {
   };
 
  private:
-  enum { kMaxHeight = 12 };
-
+  // Heights above the HeightPolicy's cap are never drawn; the head only
+  // grows as tall as the nodes actually linked.
+  enum { kMaxHeight = HeightPolicy::kMaxHeight };
+  // Increase height with probability 1 in kBranching
+  enum { kBranching = HeightPolicy::kBranching };
+  // An empty list's head covers about 64K nodes, so InsertConcurrently()
+  // stays logarithmic that far without Reserve().
+  enum {
+    kInitialHeight = height_policy::LevelsFor(1 << 16, kBranching) < kMaxHeight
+                         ? height_policy::LevelsFor(1 << 16, kBranching)
+                         : kMaxHeight
+  };
+  // Default for ApproximateCount(): a few dozen comparisons, about 25%
+  // relative error (the standard deviation of a count of 16 is 4); the
+  // error falls like 1/sqrt(min_samples), 100 gives about 10%.
+  enum { kApproximateSamples = 16 };
+  // Retired nodes are reclaimed in batches of at least this many, each
+  // costs an epoch advance and a process-wide barrier.
+  enum { kReclaimBatch = 64 };
+
+  // Acquire, and before Head(): a head published ahead of a raise of
+  // max_height_ is at least that tall.
   inline int GetMaxHeight() const {
-    return max_height_.load(std::memory_order_relaxed);
+    return max_height_.load(std::memory_order_acquire);
   }
 
+  Node* Head() const { return head_.load(std::memory_order_acquire); }
+
   inline void SetMaxHeight(size_t height) {
     max_height_.store(height, std::memory_order_relaxed);
   }
 
   Node* NewNode(const Key& key, int height);
-  int RandomHeight();
+  // Links a new node of the given height for key after prev[], which holds
+  // the last node < key on every level below GetMaxHeight().  On return
+  // prev[i] is the new node for the levels it is linked on, so prev[] is
+  // still a valid splice for any key after key.  rank[i] is the index + 1
+  // of prev[i] (0 for head_), used and updated only if Indexed.
+  Node* LinkNewNode(const Key& key, int height, Node** prev, size_t* rank);
+  // Publishes a copy of the head with height links and retires the old
+  // one.  Entries of prev (if non-null) below GetMaxHeight() that point at
+  // the old head are moved to the new one.
+  void GrowHead(int height, Node** prev);
+  // Updates the counters for a node of the given height that was just
+  // linked.  Safe to call from concurrent InsertConcurrently() calls.
+  void CountNewNode(Node* x, int height);
+  // Allocates the head and resets the counters, leaving an empty list.
+  void InitEmpty();
+  // Gives every node, the head included, back to the allocator.
+  void FreeAllNodes();
+  // Destroys an unlinked node and returns its memory to the allocator.
+  void FreeNode(Node* x, int height);
+  // Frees the retired nodes no reader can reach any more.
+  void ReclaimRetired();
+  typedef SkipListLink<Node, Indexed> Link;
+  static size_t NodeSize(int height) {
+    return sizeof(Node) + sizeof(Link) * (height - 1);
+  }
+  typedef SkipListKeyTraits<Key> KeyTraits;
+  // NodeSize() plus the key bytes stored inline after the tower.
+  static size_t NodeBytes(const Key& key, int height) {
+    return NodeSize(height) + KeyTraits::ExtraBytes(key);
+  }
+  // Bytes the allocator really took for a node of the requested size.
+  size_t AllocatedSize(void* node, size_t size) const;
+  int RandomHeight() { return height_policy_.Height(kMaxHeight); }
+  // A generator per thread for InsertConcurrently(), which cannot share
+  // height_policy_.
+  static HeightPolicy* ThreadHeightPolicy();
   bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
   // Return true if key is greater than the data stored in "n"
@@ -136,38 +460,73 @@ class SkipList {
   // Return nullptr if there is no such node.
   //
   // If prev is non-null, fills prev[level] with pointer to previous
-  // node at "level" for every level in [0..max_height_-1].
-  Node* FindGreaterOrEqual(const Key& key, Node** prev) const;
+  // node at "level" for every level in [0..max_height_-1].  If rank is
+  // non-null too (Indexed only), fills rank[level] with the index + 1 of
+  // prev[level].
+  Node* FindGreaterOrEqual(const Key& key, Node** prev,
+                           size_t* rank = nullptr) const;
+
+  // Starting at before, which must be before key, finds the last node on
+  // level whose key is < key (*out_prev) and its successor (*out_next).
+  void FindSpliceForLevel(const Key& key, Node* before, int level,
+                          Node** out_prev, Node** out_next) const;
 
   // Return the latest node with a key < key.
-  // Return head_ if there is no such node.
+  // Return nullptr if there is no such node.
   Node* FindLessThan(const Key& key) const;
 
+  // Return the node at index, nullptr if index >= size().  Indexed only.
+  Node* SelectNode(size_t index) const;
+
   // Return the last node in the list.
-  // Return head_ if list is empty.
+  // Return nullptr if list is empty.
   Node* FindLast() const;
 
   // Immutable after construction
   Comparator const compare_;
-  
-  // Arena* const arena_;  // Arena used for allocations of nodes
-  MemoryPoolTLSF* const tlsf_;
 
-  Node* const head_;
+  // Allocates and frees the nodes, used by Insert() and Delete() only.
+  Allocator allocator_;
+
+  // Replaced by Clear(), and by GrowHead() with a taller copy.
+  std::atomic<Node*> head_;
+  // Links of head_.  Written only by Insert(), read by
+  // InsertConcurrently() and the statistics.
+  std::atomic<int> head_height_;
 
   // Modified only by Insert().  Read racily by readers, but stale
-  // values are ok.
+  // values are ok.  InsertConcurrently() only ever raises it, with a CAS.
   std::atomic<int> max_height_;  // Height of the entire list
 
   // Read/written only by Insert().
-  Random rnd_;
-
-  size_t count_ {0};
+  HeightPolicy height_policy_;
+
+  // Written by Insert() and Delete(), and with relaxed read-modify-writes
+  // by InsertConcurrently().  height_nodes_[h - 1] is the number of nodes
+  // of height h.
+  std::atomic<size_t> count_ {0};
+  std::atomic<size_t> height_nodes_[kMaxHeight] = {};
+  std::atomic<size_t> allocated_bytes_ {0};
+  std::atomic<size_t> key_bytes_ {0};
+
+  // Nodes unlinked by Delete() in order, with the epoch after which they
+  // can be freed (0 until ReclaimRetired() assigns it).  Read/written only
+  // by Delete(), Clear() and the destructor.
+  struct RetiredNode {
+    Node* node;
+    int height;
+    uint64_t epoch;
+  };
+  std::vector<RetiredNode> retired_;
+  size_t retired_bytes_ {0};
+  size_t reclaim_threshold_ {kReclaimBatch};
 };
 
 // Implementation details follow
-template <typename Key, class Comparator>
-struct SkipList<Key, Comparator>::Node {
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+struct SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+                HeightPolicy>::Node : public SkipListPrevLink<Node, PrevLinks> {
   explicit Node(const Key& k) : key(k) {}
 
   Key const key;
@@ -178,135 +537,178 @@ struct SkipList<Key, Comparator>::Node {
     assert(n >= 0);
     // Use an 'acquire load' so that we observe a fully initialized
     // version of the returned Node.
-    return next_[n].load(std::memory_order_acquire);
+    return next_[n].next.load(std::memory_order_acquire);
   }
   void SetNext(int n, Node* x) {
     assert(n >= 0);
     // Use a 'release store' so that anybody who reads through this
     // pointer observes a fully initialized version of the inserted node.
-    next_[n].store(x, std::memory_order_release);
+    next_[n].next.store(x, std::memory_order_release);
   }
 
   // No-barrier variants that can be safely used in a few locations.
   Node* NoBarrier_Next(int n) {
     assert(n >= 0);
-    return next_[n].load(std::memory_order_relaxed);
+    return next_[n].next.load(std::memory_order_relaxed);
   }
   void NoBarrier_SetNext(int n, Node* x) {
     assert(n >= 0);
-    next_[n].store(x, std::memory_order_relaxed);
+    next_[n].next.store(x, std::memory_order_relaxed);
   }
 
+  // Publishes x on level n if the link still points at expected.  Like
+  // SetNext(), anybody who reads x through the link sees it initialized.
+  bool CASNext(int n, Node* expected, Node* x) {
+    assert(n >= 0);
+    return next_[n].next.compare_exchange_strong(expected, x);
+  }
+
+  // Level-0 steps the link on level n skips, always 0 unless Indexed.
+  size_t Span(int n) const { return next_[n].Span(); }
+  void SetSpan(int n, size_t span) { next_[n].SetSpan(span); }
+
  private:
   // Array of length equal to the node height.  next_[0] is lowest level link.
-  std::atomic<Node*> next_[1];
+  Link next_[1];
 };
 
-template <typename Key, class Comparator>
-typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::NewNode(
-    const Key& key, int height) {
-
-  size_t size = sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1);
-
-  // char* const node_memory = arena_->AllocateAligned(
-  //     sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
-
-  // 使用tlsf作为内存分配器
-  void* node_memory = nullptr;
-  if (tlsf_ == nullptr) {
-    node_memory = malloc(size);
-  }
-  else {
-    node_memory = tlsf_->malloc(size);
-  }
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+typename SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+                  HeightPolicy>::Node*
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::NewNode(const Key& key, int height) {
+  char* node_memory = static_cast<char*>(
+      allocator_.Allocate(NodeBytes(key, height), alignof(Node)));
+  return new (node_memory)
+      Node(KeyTraits::Place(key, node_memory + NodeSize(height)));
+}
 
-  return new (node_memory) Node(key);
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+size_t
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::AllocatedSize(void* node, size_t size) const {
+  return allocator_.AllocatedSize(node, size);
 }
 
-template <typename Key, class Comparator>
-inline SkipList<Key, Comparator>::Iterator::Iterator(const SkipList* list) {
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+inline SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+                HeightPolicy>::Iterator::Iterator(const SkipList* list) {
   list_ = list;
   node_ = nullptr;
 }
 
-template <typename Key, class Comparator>
-inline bool SkipList<Key, Comparator>::Iterator::Valid() const {
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+inline bool
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Iterator::Valid() const {
   return node_ != nullptr;
 }
 
-template <typename Key, class Comparator>
-inline const Key& SkipList<Key, Comparator>::Iterator::key() const {
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+inline const Key&
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Iterator::key() const {
   assert(Valid());
   return node_->key;
 }
 
-template <typename Key, class Comparator>
-inline void SkipList<Key, Comparator>::Iterator::Next() {
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+inline void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Iterator::Next() {
   assert(Valid());
   node_ = node_->Next(0);
 }
 
-template <typename Key, class Comparator>
-inline void SkipList<Key, Comparator>::Iterator::Prev() {
-  // Instead of using explicit "prev" links, we just search for the
-  // last node that falls before key.
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+inline void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Iterator::Prev() {
+  // Without explicit "prev" links, we just search for the last node
+  // that falls before key.
   assert(Valid());
-  node_ = list_->FindLessThan(node_->key);
-  if (node_ == list_->head_) {
-    node_ = nullptr;
-  }
+  node_ = PrevLinks ? node_->Prev() : list_->FindLessThan(node_->key);
 }
 
-template <typename Key, class Comparator>
-inline void SkipList<Key, Comparator>::Iterator::Seek(const Key& target) {
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+inline void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Iterator::Seek(const Key& target) {
   node_ = list_->FindGreaterOrEqual(target, nullptr);
 }
 
-template <typename Key, class Comparator>
-inline void SkipList<Key, Comparator>::Iterator::SeekToFirst() {
-  node_ = list_->head_->Next(0);
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+inline void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Iterator::SeekToFirst() {
+  node_ = list_->Head()->Next(0);
 }
 
-template <typename Key, class Comparator>
-inline void SkipList<Key, Comparator>::Iterator::SeekToLast() {
-  node_ = list_->FindLast();
-  if (node_ == list_->head_) {
-    node_ = nullptr;
-  }
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+inline void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Iterator::SeekToLast() {
+  node_ = PrevLinks ? list_->Head()->Prev() : list_->FindLast();
 }
 
-template <typename Key, class Comparator>
-int SkipList<Key, Comparator>::RandomHeight() {
-  // Increase height with probability 1 in kBranching
-  static const unsigned int kBranching = 4;
-  int height = 1;
-  while (height < kMaxHeight && ((rnd_.Next() % kBranching) == 0)) {
-    height++;
-  }
-  assert(height > 0);
-  assert(height <= kMaxHeight);
-  return height;
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+inline void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Iterator::SeekToIndex(size_t index) {
+  node_ = list_->SelectNode(index);
 }
 
-template <typename Key, class Comparator>
-bool SkipList<Key, Comparator>::KeyIsAfterNode(const Key& key, Node* n) const {
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+HeightPolicy*
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::ThreadHeightPolicy() {
+  // Every thread draws from a stream of its own, 0 is height_policy_'s.
+  static std::atomic<uint64_t> stream(1);
+  thread_local HeightPolicy policy(
+      stream.fetch_add(1, std::memory_order_relaxed));
+  return &policy;
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+bool
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::KeyIsAfterNode(const Key& key, Node* n) const {
   // null n is considered infinite
   return (n != nullptr) && (compare_(n->key, key) < 0);
 }
 
-template <typename Key, class Comparator>
-typename SkipList<Key, Comparator>::Node*
-SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key,
-                                              Node** prev) const {
-  Node* x = head_;
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+typename SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+                  HeightPolicy>::Node*
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::FindGreaterOrEqual(const Key& key, Node** prev,
+                                           size_t* rank) const {
   int level = GetMaxHeight() - 1;
+  Node* x = Head();
+  size_t x_rank = 0;
   while (true) {
     Node* next = x->Next(level);
     if (KeyIsAfterNode(key, next)) {
       // Keep searching in this list
+      if (Indexed) x_rank += x->Span(level);
       x = next;
     } else {
       if (prev != nullptr) prev[level] = x;
+      if (Indexed && rank != nullptr) rank[level] = x_rank;
       if (level == 0) {
         return next;
       } else {
@@ -317,17 +719,39 @@ SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key,
   }
 }
 
-template <typename Key, class Comparator>
-typename SkipList<Key, Comparator>::Node*
-SkipList<Key, Comparator>::FindLessThan(const Key& key) const {
-  Node* x = head_;
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::FindSpliceForLevel(const Key& key, Node* before,
+                                           int level, Node** out_prev,
+                                           Node** out_next) const {
+  while (true) {
+    Node* next = before->Next(level);
+    if (!KeyIsAfterNode(key, next)) {
+      *out_prev = before;
+      *out_next = next;
+      return;
+    }
+    before = next;
+  }
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+typename SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+                  HeightPolicy>::Node*
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::FindLessThan(const Key& key) const {
   int level = GetMaxHeight() - 1;
+  Node* const head = Head();
+  Node* x = head;
   while (true) {
-    assert(x == head_ || compare_(x->key, key) < 0);
+    assert(x == head || compare_(x->key, key) < 0);
     Node* next = x->Next(level);
     if (next == nullptr || compare_(next->key, key) >= 0) {
       if (level == 0) {
-        return x;
+        return x != head ? x : nullptr;
       } else {
         // Switch to next list
         level--;
@@ -338,16 +762,20 @@ SkipList<Key, Comparator>::FindLessThan(const Key& key) const {
   }
 }
 
-template <typename Key, class Comparator>
-typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::FindLast()
-    const {
-  Node* x = head_;
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+typename SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+                  HeightPolicy>::Node*
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::FindLast() const {
   int level = GetMaxHeight() - 1;
+  Node* const head = Head();
+  Node* x = head;
   while (true) {
     Node* next = x->Next(level);
     if (next == nullptr) {
       if (level == 0) {
-        return x;
+        return x != head ? x : nullptr;
       } else {
         // Switch to next list
         level--;
@@ -358,39 +786,331 @@ typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::FindLast()
   }
 }
 
-template <typename Key, class Comparator>
-SkipList<Key, Comparator>::SkipList(Comparator cmp, MemoryPoolTLSF* tlsf)
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::SkipList(Comparator cmp, Allocator allocator)
     : compare_(cmp),
-      tlsf_(tlsf),
-      head_(NewNode(0 /* any key will do */, kMaxHeight)),
+      allocator_(std::move(allocator)),
+      head_(nullptr),
+      head_height_(0),
       max_height_(1),
-      rnd_(0xdeadbeef) {
+      height_policy_(0) {
+  InitEmpty();
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+template <typename InputIt>
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::SkipList(Comparator cmp, InputIt first, InputIt last,
+                                 Allocator allocator)
+    : SkipList(cmp, std::move(allocator)) {
+  Assign(first, last);
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+template <typename InputIt>
+void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Assign(InputIt first, InputIt last) {
+  Clear();
+  // Every node is appended, so the splice is always the tail of each level.
+  Node* prev[kMaxHeight];
+  size_t rank[kMaxHeight];
   for (int i = 0; i < kMaxHeight; i++) {
-    head_->SetNext(i, nullptr);
+    prev[i] = Head();
+    rank[i] = 0;
+  }
+  size_t index = 0;
+  for (; first != last; ++first) {
+    const Key& key = *first;
+    if (prev[0] != Head() && Equal(key, prev[0]->key)) {
+      continue;
+    }
+    assert(prev[0] == Head() || compare_(prev[0]->key, key) < 0);
+    // The index-th node (from 1) is as high as the number of times
+    // kBranching divides index, plus one.
+    index++;
+    int height = 1;
+    for (size_t m = index; height < kMaxHeight && m % kBranching == 0;
+         m /= kBranching) {
+      height++;
+    }
+    LinkNewNode(key, height, prev, rank);
   }
 }
 
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::~SkipList() {
+  FreeAllNodes();
+}
 
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Clear() {
+  FreeAllNodes();
+  InitEmpty();
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::InitEmpty() {
+  // Grown by GrowHead() as taller nodes arrive.
+  Node* head =
+      NewNode(KeyTraits::HeadKey() /* any key will do */, kInitialHeight);
+  for (int i = 0; i < kInitialHeight; i++) {
+    head->SetNext(i, nullptr);
+    head->SetSpan(i, 0);
+  }
+  head->NoBarrier_SetPrev(nullptr);
+  head_.store(head, std::memory_order_release);
+  head_height_.store(kInitialHeight, std::memory_order_relaxed);
+  for (int i = 0; i < kMaxHeight; i++) {
+    height_nodes_[i].store(0, std::memory_order_relaxed);
+  }
+  max_height_.store(1, std::memory_order_relaxed);
+  count_.store(0, std::memory_order_relaxed);
+  key_bytes_.store(0, std::memory_order_relaxed);
+  allocated_bytes_.store(
+      AllocatedSize(head, NodeBytes(head->key, kInitialHeight)),
+      std::memory_order_relaxed);
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::FreeAllNodes() {
+  std::vector<RetiredNode> retired;
+  retired.swap(retired_);
+  retired_bytes_ = 0;
+  reclaim_threshold_ = kReclaimBatch;
+  if (std::is_trivially_destructible<Key>::value && allocator_.ReleaseAll()) {
+    return;
+  }
+  for (const RetiredNode& r : retired) {
+    FreeNode(r.node, r.height);
+  }
+  // Nodes do not store their height, but a node of height h is the next
+  // node on exactly levels 0..h-1 when it is reached on level 0.
+  Node* const head = head_.load(std::memory_order_relaxed);
+  const int head_height = head_height_.load(std::memory_order_relaxed);
+  Node* level_next[kMaxHeight];
+  for (int i = 0; i < head_height; i++) {
+    level_next[i] = head->NoBarrier_Next(i);
+  }
+  Node* x = head->NoBarrier_Next(0);
+  while (x != nullptr) {
+    int height = 0;
+    while (height < head_height && level_next[height] == x) {
+      level_next[height] = x->NoBarrier_Next(height);
+      height++;
+    }
+    Node* next = level_next[0];
+    FreeNode(x, height);
+    x = next;
+  }
+  FreeNode(head, head_height);
+  head_.store(nullptr, std::memory_order_relaxed);
+}
 
-template <typename Key, class Comparator>
-void SkipList<Key, Comparator>::Insert(const Key& key) {
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::FreeNode(Node* x, int height) {
+  const size_t bytes = NodeBytes(x->key, height);
+  x->~Node();
+  allocator_.Deallocate(x, bytes, alignof(Node));
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::ReclaimRetired() {
+  EpochDomain& domain = EpochDomain::Instance();
+  // Everything retired so far was unlinked before the new epoch started.
+  const uint64_t epoch = domain.Advance();
+  for (size_t i = retired_.size(); i > 0 && retired_[i - 1].epoch == 0; i--) {
+    retired_[i - 1].epoch = epoch;
+  }
+  const uint64_t oldest = domain.OldestReader();
+  size_t freed = 0;
+  while (freed < retired_.size() && retired_[freed].epoch <= oldest) {
+    const RetiredNode& r = retired_[freed];
+    size_t bytes = AllocatedSize(r.node, NodeBytes(r.node->key, r.height));
+    retired_bytes_ -= bytes;
+    allocated_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    FreeNode(r.node, r.height);
+    freed++;
+  }
+  retired_.erase(retired_.begin(), retired_.begin() + freed);
+  // A long reader keeps nodes back; do not retry on every Delete().
+  reclaim_threshold_ = std::max<size_t>(kReclaimBatch, 2 * retired_.size());
+}
+
+
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+bool
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Insert(const Key& key) {
+  return FindOrInsert(key).second;
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+std::pair<const Key*, bool>
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::FindOrInsert(const Key& key) {
   // TODO(opt): We can use a barrier-free variant of FindGreaterOrEqual()
   // here since Insert() is externally synchronized.
   Node* prev[kMaxHeight];
-  Node* x = FindGreaterOrEqual(key, prev);
+  size_t rank[kMaxHeight];
+  Node* x = FindGreaterOrEqual(key, prev, rank);
+
+  // Our data structure does not allow duplicate insertion
+  if (x != nullptr && Equal(key, x->key)) {
+    return std::make_pair(&x->key, false);
+  }
 
+  x = LinkNewNode(key, RandomHeight(), prev, rank);
+  return std::make_pair(&x->key, true);
+}
 
-  if (!(x == nullptr || !Equal(key, x->key))) {
-    printf("Insert failed, duplicate key.");
-    return;
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+bool
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::InsertConcurrently(const Key& key) {
+  static_assert(!PrevLinks && !Indexed,
+                "concurrent writers cannot keep backward links or spans");
+  const int height = ThreadHeightPolicy()->Height(
+      head_height_.load(std::memory_order_relaxed));
+
+  // Raise max_height_ first.  Readers that see the new height before the
+  // node is linked find nullptr on the new levels of head_ and drop down,
+  // as in LinkNewNode().  The head is already tall enough.
+  int max_height = GetMaxHeight();
+  while (height > max_height) {
+    if (max_height_.compare_exchange_weak(max_height, height,
+                                          std::memory_order_relaxed)) {
+      SKIPLIST_TRACEPOINT(leveldb_grow_height, this, max_height, height);
+      max_height = height;
+      break;
+    }
   }
-  // Our data structure does not allow duplicate insertion
-  assert(x == nullptr || !Equal(key, x->key));
 
-  int height = RandomHeight();
+  Node* prev[kMaxHeight];
+  Node* next[kMaxHeight];
+  Node* before = Head();
+  for (int i = max_height - 1; i >= 0; i--) {
+    FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+    before = prev[i];
+  }
+  if (next[0] != nullptr && Equal(key, next[0]->key)) {
+    return false;
+  }
+
+  Node* x = NewNode(key, height);
+  for (int i = 0; i < height; i++) {
+    while (true) {
+      x->NoBarrier_SetNext(i, next[i]);
+      if (prev[i]->CASNext(i, next[i], x)) {
+        break;
+      }
+      // Another writer linked a node after prev[i].  Nodes are never
+      // removed while InsertConcurrently() runs, so prev[i] is still
+      // before key and the search resumes from it.
+      FindSpliceForLevel(key, prev[i], i, &prev[i], &next[i]);
+      if (i == 0 && next[0] != nullptr && Equal(key, next[0]->key)) {
+        // An equal key won the race.  x was not published on any level.
+        FreeNode(x, height);
+        return false;
+      }
+    }
+  }
+  CountNewNode(x, height);
+  return true;
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+template <typename InputIt>
+size_t
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::InsertBatch(InputIt first, InputIt last) {
+  Node* prev[kMaxHeight];
+  size_t rank[kMaxHeight];
+  for (int i = 0; i < kMaxHeight; i++) {
+    prev[i] = Head();
+    rank[i] = 0;
+  }
+  size_t inserted = 0;
+  for (; first != last; ++first) {
+    const Key& key = *first;
+    // Keys ascend, so every prev[i] is still before key, but the successors
+    // may not be after it any more.  Successors sit further right on higher
+    // levels: find the lowest level whose successor is still >= key.
+    const int max_height = GetMaxHeight();
+    int level = 0;
+    while (level < max_height &&
+           KeyIsAfterNode(key, prev[level]->Next(level))) {
+      level++;
+    }
+    if (level > 0) {
+      // Redo the search below that level from its predecessor, or from the
+      // top predecessor when the key jumped past all of them.
+      const int top = level < max_height ? level : max_height - 1;
+      Node* x = prev[top];
+      size_t x_rank = rank[top];
+      for (int i = level - 1; i >= 0; i--) {
+        Node* next = x->Next(i);
+        while (KeyIsAfterNode(key, next)) {
+          if (Indexed) x_rank += x->Span(i);
+          x = next;
+          next = x->Next(i);
+        }
+        prev[i] = x;
+        rank[i] = x_rank;
+      }
+    }
+    // A repeated key finds the node of its first occurrence in prev[0].
+    Node* next = prev[0]->Next(0);
+    if ((next != nullptr && Equal(key, next->key)) ||
+        (prev[0] != Head() && Equal(key, prev[0]->key))) {
+      continue;
+    }
+    LinkNewNode(key, RandomHeight(), prev, rank);
+    inserted++;
+  }
+  return inserted;
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+typename SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+                  HeightPolicy>::Node*
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::LinkNewNode(const Key& key, int height, Node** prev,
+                                    size_t* rank) {
   if (height > GetMaxHeight()) {
+    if (height > head_height_.load(std::memory_order_relaxed)) {
+      GrowHead(height, prev);
+    }
     for (int i = GetMaxHeight(); i < height; i++) {
-      prev[i] = head_;
+      prev[i] = Head();
+      if (Indexed) rank[i] = 0;
     }
     // It is ok to mutate max_height_ without any synchronization
     // with concurrent readers.  A concurrent reader that observes
@@ -399,48 +1119,159 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
     // the loop below.  In the former case the reader will
     // immediately drop to the next level since nullptr sorts after all
     // keys.  In the latter case the reader will use the new node.
-    max_height_.store(height, std::memory_order_relaxed);
+    SKIPLIST_TRACEPOINT(leveldb_grow_height, this, GetMaxHeight(), height);
+    max_height_.store(height, std::memory_order_release);
   }
 
-  x = NewNode(key, height);
+  Node* const head = Head();
+  Node* x = NewNode(key, height);
+  x->NoBarrier_SetPrev(prev[0] != head ? prev[0] : nullptr);
+  if (Indexed) {
+    // x takes index rank[0] (rank[0] + 1 counting from head_): a link of
+    // prev[i] that x splits is shared between the two, and every link
+    // passing over x above its height gets one step longer.
+    const size_t x_rank = rank[0] + 1;
+    for (int i = 0; i < height; i++) {
+      x->SetSpan(i, prev[i]->Span(i) + rank[i] + 1 - x_rank);
+      prev[i]->SetSpan(i, x_rank - rank[i]);
+      rank[i] = x_rank;
+    }
+    for (int i = height; i < GetMaxHeight(); i++) {
+      prev[i]->SetSpan(i, prev[i]->Span(i) + 1);
+    }
+  }
   for (int i = 0; i < height; i++) {
     // NoBarrier_SetNext() suffices since we will add a barrier when
     // we publish a pointer to "x" in prev[i].
     x->NoBarrier_SetNext(i, prev[i]->NoBarrier_Next(i));
     prev[i]->SetNext(i, x);
+    prev[i] = x;
+  }
+  if (PrevLinks) {
+    Node* next = x->NoBarrier_Next(0);
+    (next != nullptr ? next : head)->SetPrev(x);
   }
 
-  ++count_;
+  CountNewNode(x, height);
+  return x;
 }
 
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::GrowHead(int height, Node** prev) {
+  Node* const old_head = head_.load(std::memory_order_relaxed);
+  const int old_height = head_height_.load(std::memory_order_relaxed);
+  assert(height > old_height && height <= kMaxHeight);
+  Node* head = NewNode(KeyTraits::HeadKey(), height);
+  for (int i = 0; i < height; i++) {
+    head->NoBarrier_SetNext(i, i < old_height ? old_head->NoBarrier_Next(i)
+                                              : nullptr);
+    head->SetSpan(i, i < old_height ? old_head->Span(i) : 0);
+  }
+  head->NoBarrier_SetPrev(old_head->Prev());
+  // Before any raise of max_height_ above old_height, see GetMaxHeight().
+  head_.store(head, std::memory_order_release);
+  head_height_.store(height, std::memory_order_relaxed);
+  if (prev != nullptr) {
+    for (int i = 0; i < GetMaxHeight(); i++) {
+      if (prev[i] == old_head) {
+        prev[i] = head;
+      }
+    }
+  }
+  // Readers may still be on the old head, which no longer changes.
+  retired_.push_back(RetiredNode{old_head, old_height, 0});
+  retired_bytes_ +=
+      AllocatedSize(old_head, NodeBytes(old_head->key, old_height));
+  allocated_bytes_.fetch_add(AllocatedSize(head, NodeBytes(head->key, height)),
+                             std::memory_order_relaxed);
+}
 
-template <typename Key, class Comparator>
-bool SkipList<Key, Comparator>::Delete(const Key& key) {
-  typename SkipList<Key, Comparator>::Node* prev[SkipList<Key, Comparator>::kMaxHeight];
-  typename SkipList<Key, Comparator>::Node* x = this->FindGreaterOrEqual(key, prev);
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Reserve(size_t expected_entries) {
+  int height = 1;
+  for (size_t m = expected_entries; height < kMaxHeight && m > 1;
+       m = (m + kBranching - 1) / kBranching) {
+    height++;
+  }
+  if (height > head_height_.load(std::memory_order_relaxed)) {
+    GrowHead(height, nullptr);
+  }
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+void
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::CountNewNode(Node* x, int height) {
+  height_nodes_[height - 1].fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes_.fetch_add(AllocatedSize(x, NodeBytes(x->key, height)),
+                             std::memory_order_relaxed);
+  key_bytes_.fetch_add(KeyTraits::ExtraBytes(x->key),
+                       std::memory_order_relaxed);
+  size_t count = count_.fetch_add(1, std::memory_order_relaxed) + 1;
+  SKIPLIST_TRACEPOINT(leveldb_insert, this, height, count);
+  (void)count;
+}
+
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+bool
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Delete(const Key& key) {
+  Node* prev[kMaxHeight];
+  Node* x = FindGreaterOrEqual(key, prev);
 
   if (x != nullptr && Equal(key, x->key)) {
+    // x is linked on exactly the levels below its height
+    int height = 0;
     for (int i = 0; i < GetMaxHeight(); i++) {
-      // NoBarrier_SetNext() suffices since we will add a barrier when
-      // we publish a pointer to "x" in prev[i].
       if (prev[i]->NoBarrier_Next(i) != x) {
         break;
       }
-      prev[i]->NoBarrier_SetNext(i, x->NoBarrier_Next(i));
+      // A release-store, readers that load the new link may go on to the
+      // successor.  x itself stays intact for readers already on it.
+      prev[i]->SetNext(i, x->NoBarrier_Next(i));
+      height++;
     }
-
-    if (tlsf_ == nullptr) {
-      free(x);
+    Node* const head = Head();
+    if (PrevLinks) {
+      Node* next = x->NoBarrier_Next(0);
+      (next != nullptr ? next : head)
+          ->SetPrev(prev[0] != head ? prev[0] : nullptr);
+    }
+    if (Indexed) {
+      // The links that skipped x lose a step, the ones that ended at x
+      // take over the remainder of x's.
+      for (int i = 0; i < height; i++) {
+        prev[i]->SetSpan(i, prev[i]->Span(i) + x->Span(i) - 1);
+      }
+      for (int i = height; i < GetMaxHeight(); i++) {
+        prev[i]->SetSpan(i, prev[i]->Span(i) - 1);
+      }
     }
-    else {
-      tlsf_->free(x);
+    height_nodes_[height - 1].fetch_sub(1, std::memory_order_relaxed);
+    retired_.push_back(RetiredNode{x, height, 0});
+    key_bytes_.fetch_sub(KeyTraits::ExtraBytes(x->key),
+                         std::memory_order_relaxed);
+    retired_bytes_ += AllocatedSize(x, NodeBytes(x->key, height));
+    if (retired_.size() >= reclaim_threshold_) {
+      ReclaimRetired();
     }
 
-    while (this->GetMaxHeight() > 1 && head_->NoBarrier_Next(this->GetMaxHeight() - 1) == nullptr) {
+    while (this->GetMaxHeight() > 1 &&
+           head->NoBarrier_Next(this->GetMaxHeight() - 1) == nullptr) {
       this->SetMaxHeight(this->GetMaxHeight() - 1);
     }
-    --count_;
-    
+    size_t count = count_.fetch_sub(1, std::memory_order_relaxed) - 1;
+    SKIPLIST_TRACEPOINT(leveldb_delete, this, height, count);
+    (void)count;
     return true;
   }
 
@@ -449,8 +1280,137 @@ bool SkipList<Key, Comparator>::Delete(const Key& key) {
 
 
 
-template <typename Key, class Comparator>
-bool SkipList<Key, Comparator>::Contains(const Key& key) const {
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+typename SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+                  HeightPolicy>::StructureStats
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::GetStructureStats(size_t sample_stride) const {
+  if (sample_stride == 0) {
+    sample_stride = 1;
+  }
+  StructureStats stats;
+  stats.max_height = GetMaxHeight();
+  Node* const head = Head();
+  stats.level_nodes.assign(kMaxHeight, 0);
+  for (int level = 0; level < stats.max_height; level++) {
+    for (Node* x = head->Next(level); x != nullptr; x = x->Next(level)) {
+      stats.level_nodes[level]++;
+    }
+  }
+  stats.num_nodes = stats.level_nodes[0];
+
+  const double n = static_cast<double>(stats.num_nodes);
+  double ideal_links = 0;
+  double misplaced = 0;
+  stats.ideal_level_nodes.resize(kMaxHeight);
+  for (int level = 0; level < kMaxHeight; level++) {
+    stats.ideal_level_nodes[level] = n / std::pow(double(kBranching), level);
+    ideal_links += stats.ideal_level_nodes[level];
+    misplaced += std::fabs(stats.level_nodes[level] -
+                           stats.ideal_level_nodes[level]);
+  }
+  stats.shape_distance = ideal_links > 0 ? misplaced / (2 * ideal_links) : 0;
+  stats.ideal_search_path =
+      n > 1 ? kBranching * std::log(n) / std::log(double(kBranching)) +
+                  double(kBranching) / (kBranching - 1)
+            : 0;
+
+  // Replay FindGreaterOrEqual(key, nullptr) for the sampled keys, counting
+  // every node it loads and every comparator call.
+  std::vector<size_t> level_visits(kMaxHeight, 0);
+  size_t total_visits = 0;
+  size_t total_comparisons = 0;
+  stats.searches = 0;
+  stats.max_search_path = 0;
+  size_t index = 0;
+  for (Node* target = head->Next(0); target != nullptr;
+       target = target->Next(0), index++) {
+    if (index % sample_stride != 0) {
+      continue;
+    }
+    const Key& key = target->key;
+    size_t path = 0;
+    Node* x = head;
+    int level = stats.max_height - 1;
+    while (true) {
+      Node* next = x->Next(level);
+      level_visits[level]++;
+      path++;
+      if (next != nullptr) {
+        total_comparisons++;
+      }
+      if (KeyIsAfterNode(key, next)) {
+        x = next;
+      } else if (level == 0) {
+        break;
+      } else {
+        level--;
+      }
+    }
+    stats.searches++;
+    total_visits += path;
+    if (path > stats.max_search_path) {
+      stats.max_search_path = path;
+    }
+  }
+
+  const double searches = stats.searches ? double(stats.searches) : 1.0;
+  stats.avg_search_path = total_visits / searches;
+  stats.avg_comparisons = total_comparisons / searches;
+  stats.avg_level_visits.resize(kMaxHeight);
+  for (int level = 0; level < kMaxHeight; level++) {
+    stats.avg_level_visits[level] = level_visits[level] / searches;
+  }
+  return stats;
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+typename SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+                  HeightPolicy>::MemoryUsage
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::GetMemoryUsage() const {
+  MemoryUsage usage;
+  usage.num_nodes = 0;
+  usage.node_bytes = 0;
+  usage.height_nodes.resize(kMaxHeight);
+  usage.height_bytes.resize(kMaxHeight);
+  for (int h = 1; h <= kMaxHeight; h++) {
+    usage.height_nodes[h - 1] =
+        height_nodes_[h - 1].load(std::memory_order_relaxed);
+    usage.height_bytes[h - 1] = usage.height_nodes[h - 1] * NodeSize(h);
+    usage.num_nodes += usage.height_nodes[h - 1];
+    usage.node_bytes += usage.height_bytes[h - 1];
+  }
+  usage.head_bytes = NodeSize(head_height_.load(std::memory_order_relaxed));
+  usage.retired_nodes = retired_.size();
+  usage.retired_bytes = retired_bytes_;
+  usage.key_bytes = key_bytes_.load(std::memory_order_relaxed);
+  usage.total_bytes = allocated_bytes_.load(std::memory_order_relaxed);
+  usage.allocator_overhead = usage.total_bytes - usage.node_bytes -
+                             usage.head_bytes - usage.key_bytes -
+                             usage.retired_bytes;
+  return usage;
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+const Key*
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Find(const Key& key) const {
+  Node* x = FindGreaterOrEqual(key, nullptr);
+  if (x != nullptr && Equal(key, x->key)) {
+    return &x->key;
+  }
+  return nullptr;
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+bool
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Contains(const Key& key) const {
   Node* x = FindGreaterOrEqual(key, nullptr);
   if (x != nullptr && Equal(key, x->key)) {
     return true;
@@ -459,6 +1419,99 @@ bool SkipList<Key, Comparator>::Contains(const Key& key) const {
   }
 }
 
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+size_t
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Rank(const Key& key) const {
+  static_assert(Indexed, "Rank() needs an Indexed SkipList");
+  Node* prev[kMaxHeight];
+  size_t rank[kMaxHeight];
+  FindGreaterOrEqual(key, prev, rank);
+  return rank[0];
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+typename SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+                  HeightPolicy>::Node*
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::SelectNode(size_t index) const {
+  static_assert(Indexed, "Select() needs an Indexed SkipList");
+  // Walk down like FindGreaterOrEqual(), steering by the spans instead of
+  // the keys: head_ is at index + 1 == 0.
+  const size_t target = index + 1;
+  int level = GetMaxHeight() - 1;
+  Node* x = Head();
+  size_t x_rank = 0;
+  while (true) {
+    Node* next = x->Next(level);
+    if (next != nullptr && x_rank + x->Span(level) <= target) {
+      x_rank += x->Span(level);
+      x = next;
+      if (x_rank == target) {
+        return x;
+      }
+    } else if (level == 0) {
+      return nullptr;
+    } else {
+      level--;
+    }
+  }
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+const Key*
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::Select(size_t index) const {
+  Node* x = SelectNode(index);
+  return x != nullptr ? &x->key : nullptr;
+}
+
+template <typename Key, class Comparator, class Allocator, bool PrevLinks,
+          bool Indexed, class HeightPolicy>
+size_t
+SkipList<Key, Comparator, Allocator, PrevLinks, Indexed,
+         HeightPolicy>::ApproximateCount(const Key& begin, const Key& end,
+                                         size_t min_samples) const {
+  int level = GetMaxHeight() - 1;
+  Node* x = Head();
+  size_t scale = 1;
+  for (int i = 0; i < level; i++) {
+    scale *= kBranching;
+  }
+  while (true) {
+    Node* next = x->Next(level);
+    while (KeyIsAfterNode(begin, next)) {
+      x = next;
+      next = x->Next(level);
+    }
+    // x is the last node before begin on this level, and so on all the
+    // levels below: a lower level resumes from here.
+    size_t count = 0;
+    while (next != nullptr && compare_(next->key, end) < 0) {
+      count++;
+      next = next->Next(level);
+    }
+    if (count >= min_samples || level == 0) {
+      return count * scale;
+    }
+    level--;
+    scale /= kBranching;
+  }
+}
+
+// A SkipList over byte-string keys stored inline in the nodes, ordered by a
+// comparator over (const char*, size_t) pairs.  Insert() copies the bytes of
+// the Slice; the Slices that Find() and Iterator::key() return point into
+// the node.
+template <class RawComparator = BytewiseComparator,
+          class Allocator = TLSFAllocator, bool PrevLinks = false,
+          bool Indexed = false, class HeightPolicy = ModuloHeight<>>
+using InlineSkipList = SkipList<Slice, SliceComparator<RawComparator>,
+                                Allocator, PrevLinks, Indexed, HeightPolicy>;
+
 } // namespace skiplist
 } // namespace utility
 
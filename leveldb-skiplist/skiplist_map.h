@@ -0,0 +1,157 @@
+#ifndef STORAGE_LEVELDB_DB_SKIPLIST_MAP_H_
+#define STORAGE_LEVELDB_DB_SKIPLIST_MAP_H_
+
+#include <utility>
+
+#include "skiplist.h"
+
+/**
+ * @brief key/value版本的leveldb跳表：value与key存放在同一个节点中
+ *
+ * Put为insert-or-assign，只查找一次；Update/Apply原地修改value，不再需要
+ * Delete+Insert（两次查找、一次free和一次malloc）。所有修改操作返回bool而不是打印。
+ * 线程安全要求与SkipList相同：写操作需要外部同步；value是原地修改的，
+ * 因此读取会被修改的value时也要持有写锁，除非Value本身的读写是原子的。
+ * Value需要可默认构造（查找时用key和默认value构造探测用的entry）。
+ */
+
+namespace utility {
+namespace skiplist {
+
+template <typename Key, typename Value, class Comparator,
+          class Allocator = TLSFAllocator, bool PrevLinks = false,
+          bool Indexed = false, class HeightPolicy = ModuloHeight<>>
+class SkipListMap {
+ private:
+  // What the underlying SkipList stores.  Only the key takes part in the
+  // ordering, the value can be rewritten in place after linking.
+  struct Entry {
+    // Implicit, the SkipList builds its head from a Key.
+    Entry(const Key& k) : key(k), value() {}
+    Entry(const Key& k, const Value& v) : key(k), value(v) {}
+
+    Key key;
+    mutable Value value;
+  };
+
+  struct EntryComparator {
+    explicit EntryComparator(Comparator c) : cmp(c) {}
+    int operator()(const Entry& a, const Entry& b) const {
+      return cmp(a.key, b.key);
+    }
+    Comparator cmp;
+  };
+
+  typedef SkipList<Entry, EntryComparator, Allocator, PrevLinks, Indexed,
+                   HeightPolicy>
+      List;
+
+ public:
+  typedef typename List::MemoryUsage MemoryUsage;
+
+  explicit SkipListMap(Comparator cmp, Allocator allocator = Allocator())
+      : list_(EntryComparator(cmp), std::move(allocator)) {}
+
+  SkipListMap(const SkipListMap&) = delete;
+  SkipListMap& operator=(const SkipListMap&) = delete;
+
+  // Copies the value of key into *value.  Returns false if key is absent.
+  bool Get(const Key& key, Value* value) const {
+    const Entry* entry = list_.Find(Entry(key));
+    if (entry == nullptr) {
+      return false;
+    }
+    *value = entry->value;
+    return true;
+  }
+
+  // The value of key, nullptr if key is absent.  Valid until key is
+  // deleted.
+  const Value* Find(const Key& key) const {
+    const Entry* entry = list_.Find(Entry(key));
+    return entry != nullptr ? &entry->value : nullptr;
+  }
+
+  bool Contains(const Key& key) const { return list_.Contains(Entry(key)); }
+
+  // Indexed maps only, see SkipList::Rank() and SkipList::CountRange().
+  size_t Rank(const Key& key) const { return list_.Rank(Entry(key)); }
+  size_t CountRange(const Key& begin, const Key& end) const {
+    return list_.CountRange(Entry(begin), Entry(end));
+  }
+
+  // Inserts key with value, or assigns value to an existing key, with a
+  // single search.  Returns true if key was inserted, false if assigned.
+  bool Put(const Key& key, const Value& value) {
+    std::pair<const Entry*, bool> r = list_.FindOrInsert(Entry(key, value));
+    if (!r.second) {
+      r.first->value = value;
+    }
+    return r.second;
+  }
+
+  // Inserts key with value only if key is absent.  Returns false if it was
+  // present, leaving its value unchanged.
+  bool Insert(const Key& key, const Value& value) {
+    return list_.Insert(Entry(key, value));
+  }
+
+  // Assigns value to an existing key in place.  Returns false if key is
+  // absent.
+  bool Update(const Key& key, const Value& value) {
+    return Apply(key, [&value](Value* v) { *v = value; });
+  }
+
+  // Calls fn(Value*) on the value of key in place, e.g. to bump a counter.
+  // Returns false, without calling fn, if key is absent.
+  template <typename Fn>
+  bool Apply(const Key& key, Fn fn) {
+    const Entry* entry = list_.Find(Entry(key));
+    if (entry == nullptr) {
+      return false;
+    }
+    fn(&entry->value);
+    return true;
+  }
+
+  // Returns false if key is absent.
+  bool Delete(const Key& key) { return list_.Delete(Entry(key)); }
+
+  void Clear() { list_.Clear(); }
+
+  size_t size() { return list_.size(); }
+
+  MemoryUsage GetMemoryUsage() const { return list_.GetMemoryUsage(); }
+  size_t ApproximateMemoryUsage() const {
+    return list_.ApproximateMemoryUsage();
+  }
+
+  const Allocator& allocator() const { return list_.allocator(); }
+
+  // Iteration in key order, same contract as SkipList::Iterator.
+  class Iterator {
+   public:
+    explicit Iterator(const SkipListMap* map) : iter_(&map->list_) {}
+
+    bool Valid() const { return iter_.Valid(); }
+    const Key& key() const { return iter_.key().key; }
+    const Value& value() const { return iter_.key().value; }
+    void Next() { iter_.Next(); }
+    void Prev() { iter_.Prev(); }
+    void Seek(const Key& target) { iter_.Seek(Entry(target)); }
+    void SeekToFirst() { iter_.SeekToFirst(); }
+    void SeekToLast() { iter_.SeekToLast(); }
+    void SeekToIndex(size_t index) { iter_.SeekToIndex(index); }
+
+   private:
+    typename List::Iterator iter_;
+  };
+
+ private:
+  List list_;
+};
+
+} // namespace skiplist
+} // namespace utility
+
+#endif  // STORAGE_LEVELDB_DB_SKIPLIST_MAP_H_
@@ -161,6 +161,8 @@ public:
     }
 };
 
+// 定义SIMPLE_SKIPLIST_NO_MAIN后可将本文件作为头文件引入（例如benchmark中）
+#ifndef SIMPLE_SKIPLIST_NO_MAIN
 int main() {
     SkipList list(5, 0.5);
 
@@ -186,4 +188,5 @@ int main() {
     list.display();
 
     return 0;
-}
\ No newline at end of file
+}
+#endif  // SIMPLE_SKIPLIST_NO_MAIN
@@ -0,0 +1,134 @@
+// Runs the same random inserts and deletes on a SkipList with every node
+// allocator and on a std::set, and checks that allocators which can take
+// memory back get all of it back.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <set>
+
+#include "leveldb-skiplist/skiplist.h"
+#include "test_util.h"
+
+using namespace utility::skiplist;
+
+namespace {
+
+template <typename List>
+void RandomOps(List* list, uint64_t seed) {
+  std::set<uint64_t> model;
+  std::mt19937_64 rnd(seed);
+  for (int i = 0; i < 50000; ++i) {
+    uint64_t key = rnd() % 5000;
+    if (rnd() % 3 != 0) {
+      SKIPLIST_CHECK_EQ(list->Insert(key), model.insert(key).second);
+    } else {
+      SKIPLIST_CHECK_EQ(list->Delete(key), model.erase(key) != 0);
+    }
+    if (i % 10000 == 0) {
+      CheckSameKeys(list, model);
+    }
+  }
+  CheckSameKeys(list, model);
+}
+
+#if SKIPLIST_HAS_PMR
+// Counts the bytes that are allocated from the upstream and not yet given
+// back.
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  explicit CountingResource(std::pmr::memory_resource* upstream)
+      : upstream_(upstream), outstanding_(0), allocations_(0) {}
+
+  size_t outstanding() const { return outstanding_; }
+  size_t allocations() const { return allocations_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t align) override {
+    outstanding_ += bytes;
+    allocations_++;
+    return upstream_->allocate(bytes, align);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t align) override {
+    outstanding_ -= bytes;
+    upstream_->deallocate(p, bytes, align);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const
+      noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* upstream_;
+  size_t outstanding_;
+  size_t allocations_;
+};
+
+void TestPmrAllocator() {
+  typedef SkipList<uint64_t, U64Comparator, PmrAllocator> List;
+  {
+    // Every node, retired ones included, goes back to the resource.
+    CountingResource counting(std::pmr::new_delete_resource());
+    {
+      List list(U64Comparator(), &counting);
+      RandomOps(&list, 1);
+      SKIPLIST_CHECK(counting.outstanding() > 0);
+    }
+    SKIPLIST_CHECK_EQ(counting.outstanding(), 0u);
+  }
+  {
+    CountingResource counting(std::pmr::new_delete_resource());
+    {
+      std::pmr::monotonic_buffer_resource monotonic(&counting);
+      List list(U64Comparator(), &monotonic);
+      SKIPLIST_CHECK(list.allocator().resource() == &monotonic);
+      RandomOps(&list, 2);
+    }
+    SKIPLIST_CHECK_EQ(counting.outstanding(), 0u);
+  }
+  {
+    CountingResource counting(std::pmr::new_delete_resource());
+    {
+      std::pmr::unsynchronized_pool_resource pool(&counting);
+      List list(U64Comparator(), &pool);
+      RandomOps(&list, 3);
+      SKIPLIST_CHECK(counting.allocations() > 0);
+    }
+    SKIPLIST_CHECK_EQ(counting.outstanding(), 0u);
+  }
+}
+#endif
+
+}  // namespace
+
+int main() {
+  {
+    SkipList<uint64_t, U64Comparator> list(U64Comparator(), nullptr);
+    RandomOps(&list, 4);
+  }
+  {
+    SkipList<uint64_t, U64Comparator> list(U64Comparator(),
+                                           TLSFAllocator::Owning());
+    RandomOps(&list, 5);
+  }
+  {
+    SkipList<uint64_t, U64Comparator, MallocAllocator> list(
+        (U64Comparator()));
+    RandomOps(&list, 6);
+  }
+  {
+    Arena arena;
+    SkipList<uint64_t, U64Comparator, ArenaAllocator> list(U64Comparator(),
+                                                           &arena);
+    RandomOps(&list, 7);
+  }
+#if SKIPLIST_HAS_PMR
+  TestPmrAllocator();
+#else
+  printf("allocator_test: no std::pmr, PmrAllocator not tested\n");
+#endif
+  printf("allocator_test passed\n");
+  return 0;
+}
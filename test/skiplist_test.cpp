@@ -0,0 +1,511 @@
+// Differential tests of the leveldb SkipList against std::set: every
+// operation is applied to both and the results and contents compared.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "leveldb-skiplist/skiplist.h"
+#include "test_util.h"
+
+using namespace utility::skiplist;
+
+namespace {
+
+typedef SkipList<uint64_t, U64Comparator> List;
+
+// A sorted batch of n keys below limit, with repeats.
+std::vector<uint64_t> SortedBatch(std::mt19937_64* rnd, size_t n,
+                                  uint64_t limit) {
+  std::vector<uint64_t> batch(n);
+  for (uint64_t& key : batch) {
+    key = (*rnd)() % limit;
+  }
+  std::sort(batch.begin(), batch.end());
+  return batch;
+}
+
+// Dense and sparse batches into a list that already has keys, with deletes
+// in between, so the cached splice has to skip, re-search and start over.
+void TestInsertBatch() {
+  List list(U64Comparator(), nullptr);
+  std::set<uint64_t> model;
+  std::mt19937_64 rnd(15);
+  for (int round = 0; round < 200; ++round) {
+    uint64_t limit = round % 2 == 0 ? 2000 : 1000000;
+    std::vector<uint64_t> batch = SortedBatch(&rnd, rnd() % 500, limit);
+    size_t inserted = 0;
+    for (uint64_t key : batch) {
+      inserted += model.insert(key).second;
+    }
+    SKIPLIST_CHECK_EQ(list.InsertBatch(batch.begin(), batch.end()), inserted);
+    for (int i = 0; i < 50; ++i) {
+      uint64_t key = rnd() % limit;
+      SKIPLIST_CHECK_EQ(list.Delete(key), model.erase(key) != 0);
+    }
+    if (round % 20 == 0) {
+      CheckSameKeys(&list, model);
+    }
+  }
+  CheckSameKeys(&list, model);
+  for (uint64_t key : model) {
+    SKIPLIST_CHECK(list.Contains(key));
+  }
+}
+
+// Assign() and the range constructor drop repeats and give the i-th node
+// (from 1) one level more for every time 4 divides i.
+void TestAssign() {
+  std::mt19937_64 rnd(16);
+  List list(U64Comparator(), nullptr);
+  const size_t kSizes[] = {0, 1, 3, 4, 5, 16, 17, 1000, 100000};
+  for (size_t n : kSizes) {
+    std::vector<uint64_t> keys = SortedBatch(&rnd, n, 4 * n + 1);
+    std::set<uint64_t> model(keys.begin(), keys.end());
+    list.Assign(keys.begin(), keys.end());
+    CheckSameKeys(&list, model);
+
+    List::StructureStats stats = list.GetStructureStats(1000);
+    size_t expected = model.size();
+    for (size_t level = 0; level < stats.level_nodes.size(); ++level) {
+      SKIPLIST_CHECK_EQ(stats.level_nodes[level], expected);
+      expected /= 4;
+    }
+
+    // The balanced list takes ordinary writes afterwards.
+    for (int i = 0; i < 2000; ++i) {
+      uint64_t key = rnd() % (4 * n + 10);
+      if (i % 2 == 0) {
+        SKIPLIST_CHECK_EQ(list.Insert(key), model.insert(key).second);
+      } else {
+        SKIPLIST_CHECK_EQ(list.Delete(key), model.erase(key) != 0);
+      }
+    }
+    CheckSameKeys(&list, model);
+  }
+
+  std::vector<uint64_t> keys = SortedBatch(&rnd, 5000, 10000);
+  std::set<uint64_t> model(keys.begin(), keys.end());
+  List built(U64Comparator(), keys.begin(), keys.end(), nullptr);
+  CheckSameKeys(&built, model);
+  List from_set(U64Comparator(), model.begin(), model.end(),
+                TLSFAllocator::Owning());
+  CheckSameKeys(&from_set, model);
+}
+
+// Writers insert overlapping random keys with InsertConcurrently() while
+// readers inside an EpochGuard walk the list: exactly one writer may win
+// every key, and readers must always see ascending keys and the preloaded
+// ones.
+template <typename ConcurrentList>
+void TestInsertConcurrently(ConcurrentList* list, size_t reserve) {
+  const int kWriters = 4;
+  const int kReaders = 2;
+  const uint64_t kKeysPerWriter = 20000;
+  const uint64_t kKeySpace = 40000;
+  list->Reserve(reserve);
+  std::set<uint64_t> model;
+  for (uint64_t key = 0; key < kKeySpace; key += 97) {
+    SKIPLIST_CHECK(list->Insert(key));
+    model.insert(key);
+  }
+  const std::set<uint64_t> preloaded = model;
+
+  std::vector<std::vector<uint64_t>> won(kWriters);
+  std::atomic<int> writing(kWriters);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kWriters; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937_64 rnd(180 + t);
+      for (uint64_t i = 0; i < kKeysPerWriter; ++i) {
+        uint64_t key = rnd() % kKeySpace;
+        if (list->InsertConcurrently(key)) {
+          won[t].push_back(key);
+        }
+      }
+      writing--;
+    });
+  }
+  for (int t = 0; t < kReaders; ++t) {
+    threads.emplace_back([&] {
+      do {
+        EpochGuard guard;
+        typename ConcurrentList::Iterator iter(list);
+        auto expected = preloaded.begin();
+        uint64_t last = 0;
+        for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+          SKIPLIST_CHECK(last == 0 || last < iter.key());
+          last = iter.key();
+          if (expected != preloaded.end() && *expected == last) {
+            ++expected;
+          }
+        }
+        SKIPLIST_CHECK(expected == preloaded.end());
+      } while (writing.load() > 0);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (const auto& keys : won) {
+    for (uint64_t key : keys) {
+      SKIPLIST_CHECK(model.insert(key).second);
+    }
+  }
+  // Every key a writer tried is in the list, whoever won it.
+  for (int t = 0; t < kWriters; ++t) {
+    std::mt19937_64 replay(180 + t);
+    for (uint64_t i = 0; i < kKeysPerWriter; ++i) {
+      SKIPLIST_CHECK(model.count(replay() % kKeySpace) == 1);
+    }
+  }
+  CheckSameKeys(list, model);
+}
+
+void TestInsertConcurrently() {
+  {
+    SkipList<uint64_t, U64Comparator, MallocAllocator> list(
+        (U64Comparator()));
+    TestInsertConcurrently(&list, 0);
+  }
+  {
+    SkipList<uint64_t, U64Comparator,
+             SynchronizedAllocator<TLSFAllocator>>
+        list(U64Comparator(), TLSFAllocator::Owning());
+    TestInsertConcurrently(&list, 1 << 20);
+  }
+}
+
+// A guard keeps deleted nodes alive, its release lets them go.  These use
+// malloc, so that AddressSanitizer sees a node freed too early.
+void TestEpochDeferredFree() {
+  List list(U64Comparator(), nullptr);
+  for (uint64_t key = 0; key < 1000; ++key) {
+    list.Insert(key);
+  }
+  {
+    EpochGuard guard;
+    List::Iterator iter(&list);
+    iter.Seek(500);
+    for (uint64_t key = 0; key < 1000; key += 2) {
+      SKIPLIST_CHECK(list.Delete(key));
+    }
+    SKIPLIST_CHECK_EQ(list.GetMemoryUsage().retired_nodes, 500u);
+    // The iterator still stands on the deleted node and can move on.
+    SKIPLIST_CHECK(iter.Valid());
+    SKIPLIST_CHECK_EQ(iter.key(), 500u);
+    iter.Next();
+    SKIPLIST_CHECK(iter.Valid());
+    SKIPLIST_CHECK_EQ(iter.key(), 501u);
+  }
+  for (uint64_t key = 1; key < 200; key += 2) {
+    SKIPLIST_CHECK(list.Delete(key));
+  }
+  SKIPLIST_CHECK(list.GetMemoryUsage().retired_nodes < 100);
+}
+
+// One writer inserts and deletes under the usual external lock (here the
+// only writer) while readers inside EpochGuards search and iterate.  Keys
+// divisible by 4 are never deleted, so readers must always find them.
+void TestDeleteWithReaders() {
+  const uint64_t kKeySpace = 20000;
+  List list(U64Comparator(), nullptr);
+  std::set<uint64_t> model;
+  for (uint64_t key = 0; key < kKeySpace; ++key) {
+    list.Insert(key);
+    model.insert(key);
+  }
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; ++t) {
+    readers.emplace_back([&, t] {
+      std::mt19937_64 rnd(190 + t);
+      while (!done.load()) {
+        EpochGuard guard;
+        uint64_t key = (rnd() % kKeySpace) & ~uint64_t(3);
+        SKIPLIST_CHECK(list.Contains(key));
+        List::Iterator iter(&list);
+        iter.Seek(key);
+        for (int i = 0; i < 64 && iter.Valid(); ++i) {
+          SKIPLIST_CHECK(iter.key() >= key);
+          key = iter.key();
+          iter.Next();
+          SKIPLIST_CHECK(!iter.Valid() || iter.key() > key);
+        }
+      }
+    });
+  }
+  std::mt19937_64 rnd(19);
+  for (int i = 0; i < 200000; ++i) {
+    uint64_t key = rnd() % kKeySpace;
+    if (key % 4 == 0) {
+      continue;
+    }
+    if (rnd() % 2 == 0) {
+      SKIPLIST_CHECK_EQ(list.Delete(key), model.erase(key) != 0);
+    } else {
+      SKIPLIST_CHECK_EQ(list.Insert(key), model.insert(key).second);
+    }
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  CheckSameKeys(&list, model);
+}
+
+// Prev() from random Seek() positions, after every kind of write that links
+// or unlinks nodes.  Without PrevLinks the same checks cover the search
+// fallback.
+template <bool PrevLinks>
+void TestPrev() {
+  typedef SkipList<uint64_t, U64Comparator, TLSFAllocator, PrevLinks> PList;
+  std::mt19937_64 rnd(20);
+  std::vector<uint64_t> initial = SortedBatch(&rnd, 3000, 10000);
+  PList list(U64Comparator(), initial.begin(), initial.end(), nullptr);
+  std::set<uint64_t> model(initial.begin(), initial.end());
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 0; i < 500; ++i) {
+      uint64_t key = rnd() % 10000;
+      if (rnd() % 2 == 0) {
+        SKIPLIST_CHECK_EQ(list.Insert(key), model.insert(key).second);
+      } else {
+        SKIPLIST_CHECK_EQ(list.Delete(key), model.erase(key) != 0);
+      }
+    }
+    std::vector<uint64_t> batch = SortedBatch(&rnd, 200, 10000);
+    list.InsertBatch(batch.begin(), batch.end());
+    model.insert(batch.begin(), batch.end());
+    CheckSameKeys(&list, model);
+
+    typename PList::Iterator iter(&list);
+    for (int i = 0; i < 200; ++i) {
+      uint64_t key = rnd() % 10000;
+      iter.Seek(key);
+      auto it = model.lower_bound(key);
+      SKIPLIST_CHECK_EQ(iter.Valid(), it != model.end());
+      if (!iter.Valid()) {
+        continue;
+      }
+      iter.Prev();
+      SKIPLIST_CHECK_EQ(iter.Valid(), it != model.begin());
+      if (iter.Valid()) {
+        SKIPLIST_CHECK_EQ(iter.key(), *std::prev(it));
+      }
+    }
+  }
+  list.Clear();
+  typename PList::Iterator iter(&list);
+  iter.SeekToLast();
+  SKIPLIST_CHECK(!iter.Valid());
+  list.Insert(7);
+  iter.SeekToLast();
+  SKIPLIST_CHECK(iter.Valid() && iter.key() == 7);
+  iter.Prev();
+  SKIPLIST_CHECK(!iter.Valid());
+}
+
+// Rank(), Select(), CountRange() and SeekToIndex() read the link spans, so
+// they are compared with std::set after every kind of write that has to
+// keep the spans up to date.
+template <bool PrevLinks>
+void TestIndexed() {
+  typedef SkipList<uint64_t, U64Comparator, TLSFAllocator, PrevLinks, true>
+      IList;
+  std::mt19937_64 rnd(22);
+  IList list(U64Comparator(), nullptr);
+  std::set<uint64_t> model;
+  for (int round = 0; round < 30; ++round) {
+    if (round % 10 == 0) {
+      std::vector<uint64_t> keys = SortedBatch(&rnd, 2000, 8000);
+      list.Assign(keys.begin(), keys.end());
+      model = std::set<uint64_t>(keys.begin(), keys.end());
+    }
+    for (int i = 0; i < 300; ++i) {
+      uint64_t key = rnd() % 8000;
+      if (rnd() % 2 == 0) {
+        SKIPLIST_CHECK_EQ(list.Insert(key), model.insert(key).second);
+      } else {
+        SKIPLIST_CHECK_EQ(list.Delete(key), model.erase(key) != 0);
+      }
+    }
+    std::vector<uint64_t> batch = SortedBatch(&rnd, 100, 8000);
+    list.InsertBatch(batch.begin(), batch.end());
+    model.insert(batch.begin(), batch.end());
+    CheckSameKeys(&list, model);
+
+    std::vector<uint64_t> sorted(model.begin(), model.end());
+    for (size_t index = 0; index <= sorted.size(); ++index) {
+      const uint64_t* key = list.Select(index);
+      if (index == sorted.size()) {
+        SKIPLIST_CHECK(key == nullptr);
+        break;
+      }
+      SKIPLIST_CHECK(key != nullptr && *key == sorted[index]);
+      SKIPLIST_CHECK_EQ(list.Rank(sorted[index]), index);
+    }
+    typename IList::Iterator iter(&list);
+    for (int i = 0; i < 200; ++i) {
+      uint64_t begin = rnd() % 8200;
+      uint64_t end = rnd() % 8200;
+      size_t rank = std::lower_bound(sorted.begin(), sorted.end(), begin) -
+                    sorted.begin();
+      SKIPLIST_CHECK_EQ(list.Rank(begin), rank);
+      size_t count = 0;
+      for (auto it = model.lower_bound(begin);
+           it != model.end() && *it < end; ++it) {
+        count++;
+      }
+      SKIPLIST_CHECK_EQ(list.CountRange(begin, end), count);
+      iter.SeekToIndex(rank);
+      SKIPLIST_CHECK_EQ(iter.Valid(), rank < sorted.size());
+      if (iter.Valid()) {
+        SKIPLIST_CHECK_EQ(iter.key(), sorted[rank]);
+      }
+    }
+  }
+}
+
+// The default heights, except that every 1000th node is taller than the
+// last such one, so the head has to grow well before any random height
+// would get there.
+class ScriptedHeight {
+ public:
+  enum { kBranching = 4 };
+  enum { kMaxHeight = 20 };
+
+  explicit ScriptedHeight(uint64_t stream) : random_(stream), draws_(0) {}
+
+  int Height(int max_height) {
+    if (++draws_ % 1000 != 0) {
+      return random_.Height(max_height);
+    }
+    int height = 9 + static_cast<int>(draws_ / 1000);
+    return height < max_height ? height : max_height;
+  }
+
+ private:
+  ModuloHeight<4, 25, kMaxHeight> random_;
+  uint64_t draws_;
+};
+
+void TestGrowHead() {
+  typedef SkipList<uint64_t, U64Comparator, TLSFAllocator, true, true,
+                   ScriptedHeight>
+      GList;
+  GList list(U64Comparator(), nullptr);
+  const size_t initial_head = list.GetMemoryUsage().head_bytes;
+  std::set<uint64_t> model;
+  std::mt19937_64 rnd(25);
+  for (int i = 0; i < 15000; ++i) {
+    uint64_t key = rnd() % 20000;
+    if (rnd() % 4 != 0) {
+      SKIPLIST_CHECK_EQ(list.Insert(key), model.insert(key).second);
+    } else {
+      SKIPLIST_CHECK_EQ(list.Delete(key), model.erase(key) != 0);
+    }
+  }
+  SKIPLIST_CHECK(list.GetStructureStats(100).max_height > 12);
+  SKIPLIST_CHECK(list.GetMemoryUsage().head_bytes > initial_head);
+  CheckSameKeys(&list, model);
+  size_t index = 0;
+  for (uint64_t key : model) {
+    SKIPLIST_CHECK_EQ(list.Rank(key), index);
+    SKIPLIST_CHECK(*list.Select(index) == key);
+    index++;
+  }
+}
+
+// Readers inside EpochGuards search for preloaded keys while the writer
+// keeps growing the head and retiring the old ones.
+void TestGrowHeadWithReaders() {
+  typedef SkipList<uint64_t, U64Comparator, TLSFAllocator, false, false,
+                   ScriptedHeight>
+      GList;
+  GList list(U64Comparator(), nullptr);
+  for (uint64_t key = 0; key < 1000; ++key) {
+    list.Insert(key * 1000);
+  }
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; ++t) {
+    readers.emplace_back([&, t] {
+      std::mt19937_64 rnd(250 + t);
+      while (!done.load()) {
+        EpochGuard guard;
+        uint64_t key = rnd() % 1000 * 1000;
+        SKIPLIST_CHECK(list.Contains(key));
+        GList::Iterator iter(&list);
+        iter.Seek(key);
+        SKIPLIST_CHECK(iter.Valid() && iter.key() == key);
+      }
+    });
+  }
+  for (uint64_t i = 0; i < 12000; ++i) {
+    list.Insert(i * 1000 + 1 + i % 999);
+    if (i % 3 == 0) {
+      list.Delete(i * 1000 + 1 + i % 999);
+    }
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  SKIPLIST_CHECK(list.GetStructureStats(100).max_height > 12);
+}
+
+// InsertConcurrently() never grows the head: heights are capped at the
+// head an empty list starts with, or at the one Reserve() made.
+void TestReserve() {
+  typedef SkipList<uint64_t, U64Comparator, MallocAllocator, false, false,
+                   ScriptedHeight>
+      GList;
+  GList capped((U64Comparator()));
+  const size_t initial_head = capped.GetMemoryUsage().head_bytes;
+  const int initial_height = height_policy::LevelsFor(1 << 16, 4);
+  for (uint64_t key = 0; key < 5000; ++key) {
+    SKIPLIST_CHECK(capped.InsertConcurrently(key));
+  }
+  SKIPLIST_CHECK_EQ(capped.GetStructureStats(100).max_height, initial_height);
+  SKIPLIST_CHECK_EQ(capped.GetMemoryUsage().head_bytes, initial_head);
+
+  GList reserved((U64Comparator()));
+  reserved.Reserve(size_t(1) << 36);
+  SKIPLIST_CHECK(reserved.GetMemoryUsage().head_bytes > initial_head);
+  for (uint64_t key = 0; key < 5000; ++key) {
+    SKIPLIST_CHECK(reserved.InsertConcurrently(key));
+  }
+  SKIPLIST_CHECK(reserved.GetStructureStats(100).max_height > initial_height);
+  std::set<uint64_t> model;
+  for (uint64_t key = 0; key < 5000; ++key) {
+    model.insert(key);
+  }
+  CheckSameKeys(&capped, model);
+  CheckSameKeys(&reserved, model);
+}
+
+}  // namespace
+
+int main() {
+  TestInsertBatch();
+  TestAssign();
+  TestInsertConcurrently();
+  TestEpochDeferredFree();
+  TestDeleteWithReaders();
+  TestPrev<true>();
+  TestPrev<false>();
+  TestIndexed<false>();
+  TestIndexed<true>();
+  TestGrowHead();
+  TestGrowHeadWithReaders();
+  TestReserve();
+  printf("skiplist_test passed\n");
+  return 0;
+}
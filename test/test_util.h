@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+
+/**
+ * @brief 测试公共工具：失败即打印位置并退出，测试程序返回0即通过
+ */
+
+#define SKIPLIST_CHECK(cond)                                            \
+  do {                                                                  \
+    if (!(cond)) {                                                      \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond);                                                   \
+      abort();                                                          \
+    }                                                                   \
+  } while (0)
+
+#define SKIPLIST_CHECK_EQ(a, b) SKIPLIST_CHECK((a) == (b))
+
+// Checks that a leveldb SkipList (or anything with the same Iterator) holds
+// exactly the keys of model, in order, forwards and backwards.
+template <typename List>
+void CheckSameKeys(List* list, const std::set<uint64_t>& model) {
+  SKIPLIST_CHECK_EQ(list->size(), model.size());
+  typename List::Iterator iter(list);
+  iter.SeekToFirst();
+  for (uint64_t key : model) {
+    SKIPLIST_CHECK(iter.Valid());
+    SKIPLIST_CHECK_EQ(iter.key(), key);
+    iter.Next();
+  }
+  SKIPLIST_CHECK(!iter.Valid());
+  iter.SeekToLast();
+  for (auto it = model.rbegin(); it != model.rend(); ++it) {
+    SKIPLIST_CHECK(iter.Valid());
+    SKIPLIST_CHECK_EQ(iter.key(), *it);
+    iter.Prev();
+  }
+  SKIPLIST_CHECK(!iter.Valid());
+}
+
+struct U64Comparator {
+  int operator()(uint64_t a, uint64_t b) const {
+    return a < b ? -1 : (a > b ? 1 : 0);
+  }
+};
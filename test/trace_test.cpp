@@ -0,0 +1,156 @@
+// Records operations through TracingSkipList and TracingAccessor and checks
+// that ReadTrace() gives back exactly what the lists returned.
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "adapters.h"
+#include "test_util.h"
+#include "trace.h"
+
+using namespace utility::skiplist::bench;
+
+namespace {
+
+struct Expected {
+  TraceOp op;
+  uint64_t key;
+  bool result;
+};
+
+void CheckEvents(const std::vector<TraceEvent>& events,
+                 const std::vector<Expected>& expected) {
+  SKIPLIST_CHECK_EQ(events.size(), expected.size());
+  for (size_t i = 0; i < events.size(); ++i) {
+    SKIPLIST_CHECK(events[i].op == expected[i].op);
+    SKIPLIST_CHECK_EQ(events[i].key, expected[i].key);
+    SKIPLIST_CHECK_EQ(events[i].result, expected[i].result);
+    SKIPLIST_CHECK(i == 0 || events[i - 1].nanos <= events[i].nanos);
+  }
+}
+
+void TestTracingSkipList(const std::string& path) {
+  typedef utility::skiplist::SkipList<BenchKey, LevelDBComparator> List;
+  List list(LevelDBComparator(), utility::skiplist::TLSFAllocator::Owning());
+  std::set<BenchKey> model;
+  std::vector<Expected> expected;
+  {
+    TraceWriter writer(path);
+    SKIPLIST_CHECK(writer.ok());
+    TracingSkipList<List> traced(&list, &writer);
+    std::mt19937_64 rnd(301);
+    for (int i = 0; i < 20000; ++i) {
+      BenchKey key = rnd() % 2000;
+      switch (rnd() % 4) {
+        case 0: {
+          bool inserted = model.insert(key).second;
+          SKIPLIST_CHECK_EQ(traced.Insert(key), inserted);
+          expected.push_back({TraceOp::kInsert, key, inserted});
+          break;
+        }
+        case 1: {
+          bool erased = model.erase(key) != 0;
+          SKIPLIST_CHECK_EQ(traced.Delete(key), erased);
+          expected.push_back({TraceOp::kErase, key, erased});
+          break;
+        }
+        case 2: {
+          bool found = model.count(key) != 0;
+          SKIPLIST_CHECK_EQ(traced.Contains(key), found);
+          expected.push_back({TraceOp::kContains, key, found});
+          break;
+        }
+        default: {
+          List::Iterator iter(&list);
+          traced.Seek(&iter, key);
+          auto lower = model.lower_bound(key);
+          SKIPLIST_CHECK_EQ(iter.Valid(), lower != model.end());
+          SKIPLIST_CHECK(!iter.Valid() || iter.key() == *lower);
+          expected.push_back({TraceOp::kSeek, key, iter.Valid()});
+          break;
+        }
+      }
+    }
+  }
+
+  Trace trace;
+  std::string error;
+  SKIPLIST_CHECK(ReadTrace(path, &trace, &error));
+  SKIPLIST_CHECK_EQ(trace.threads.size(), 1u);
+  CheckEvents(trace.threads[0], expected);
+}
+
+// Every thread works on its own keys, so each one's results are known.
+void TestTracingAccessor(const std::string& path) {
+  typedef utility::skiplist::ConcurrentSkipList<BenchKey> List;
+  typedef TracingAccessor<List::Accessor> Traced;
+  const int kThreads = 4;
+  const BenchKey kKeys = 3000;
+  auto list = List::createInstance(1);
+  std::vector<std::vector<Expected>> expected(kThreads);
+  {
+    TraceWriter writer(path);
+    SKIPLIST_CHECK(writer.ok());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&, t] {
+        Traced traced(List::Accessor(list), &writer);
+        std::vector<Expected>& out = expected[t];
+        for (BenchKey i = 0; i < kKeys; ++i) {
+          BenchKey key = i * kThreads + t;
+          SKIPLIST_CHECK(traced.add(key));
+          out.push_back({TraceOp::kInsert, key, true});
+        }
+        for (BenchKey i = 0; i < kKeys; i += 2) {
+          BenchKey key = i * kThreads + t;
+          SKIPLIST_CHECK(traced.remove(key));
+          out.push_back({TraceOp::kErase, key, true});
+          SKIPLIST_CHECK(!traced.insert(key + kThreads).second);
+          out.push_back({TraceOp::kInsert, key + kThreads, false});
+        }
+        for (BenchKey i = 0; i < kKeys; ++i) {
+          BenchKey key = i * kThreads + t;
+          bool present = i % 2 == 1;
+          SKIPLIST_CHECK_EQ(traced.contains(key), present);
+          out.push_back({TraceOp::kContains, key, present});
+          SKIPLIST_CHECK_EQ(traced.find(key) != traced.end(), present);
+          out.push_back({TraceOp::kContains, key, present});
+        }
+        BenchKey last = (kKeys - 1) * kThreads + t;
+        SKIPLIST_CHECK(traced.lower_bound(last) != traced.end());
+        out.push_back({TraceOp::kSeek, last, true});
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  Trace trace;
+  std::string error;
+  SKIPLIST_CHECK(ReadTrace(path, &trace, &error));
+  SKIPLIST_CHECK_EQ(trace.threads.size(), static_cast<size_t>(kThreads));
+  // Recorded thread numbers follow the order of each thread's first event,
+  // match them up by the first key.
+  for (const auto& events : trace.threads) {
+    SKIPLIST_CHECK(!events.empty());
+    int t = static_cast<int>(events.front().key % kThreads);
+    CheckEvents(events, expected[t]);
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestTracingSkipList("trace_test_skiplist.trace");
+  TestTracingAccessor("trace_test_accessor.trace");
+  remove("trace_test_skiplist.trace");
+  remove("trace_test_accessor.trace");
+  printf("trace_test passed\n");
+  return 0;
+}